@@ -0,0 +1,437 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include "Kernel.hpp"
+#include "Parser.hpp"
+
+// Times the alternative reductions, element types, sorts and radix select on the selected device over the same input,
+// and the host parsers over the same file, so each set can be compared
+class Benchmark
+{
+	struct Result
+	{
+		string name;
+		double seconds;
+		string value;
+	};
+
+	Kernel<mytype>& kernel;
+	vector<Result> results;
+
+	// Total execution time of a set of kernel launches in seconds
+	static double kernelSeconds(const vector<cl::Event>& events)
+	{
+		double nanoseconds = 0;
+		for (const cl::Event& kernelEvent : events)
+			nanoseconds += kernelEvent.getProfilingInfo<CL_PROFILING_COMMAND_END>() - kernelEvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+		return nanoseconds / 1e+9;
+	}
+
+public:
+	// Number of times each variant is run, its fastest time is kept
+	size_t repeats = 10;
+
+	Benchmark(Kernel<mytype>& _kernel) : kernel(_kernel) {}
+
+	// Runs a variant a number of times, keeping its fastest kernel time and the result it returns
+	void run(string name, function<string(vector<cl::Event>&)> variant)
+	{
+		Result result = { name, numeric_limits<double>::max(), "" };
+		try
+		{
+			for (size_t i = 0; i < repeats; i++)
+			{
+				vector<cl::Event> events;
+				result.value = variant(events);
+				kernel.finish();
+				result.seconds = min(result.seconds, kernelSeconds(events));
+			}
+		}
+		catch (const cl::Error& err)
+		{
+			// Keep the other variants' results
+			result = failed(name, err);
+		}
+		results.push_back(result);
+	}
+
+	// Result of a variant that the device rejected
+	static Result failed(string name, const cl::Error& err)
+	{
+		return { name, 0, string("failed, ") + err.what() + ", " + getErrorString(err.err()) };
+	}
+
+	// Runs a min, max and sum kernel that each finish with a global atomic, one element per work-item.
+	// The sum is 64-bit, reduced with a second launch on devices without 64-bit atomics.
+	string runAtomic(const string names[3], cl::Buffer input, size_t dataSize, size_t globalSize, size_t localSize, vector<cl::Event>& events)
+	{
+		size_t groups = globalSize / localSize;
+		cl::Buffer minBuffer = kernel.createBuffer<cl_int>(1, numeric_limits<cl_int>::max());
+		cl::Buffer maxBuffer = kernel.createBuffer<cl_int>(1, numeric_limits<cl_int>::min());
+		cl::Buffer sumBuffer = kernel.createLongResults(groups);
+		cl::Event minEvent, maxEvent, sumEvent;
+		kernel.executeKernel(names[0], kernel.createKernel(names[0], input, minBuffer, cl::Local(localSize * sizeof(cl_int)), (cl_int)dataSize), globalSize, localSize, minEvent);
+		kernel.executeKernel(names[1], kernel.createKernel(names[1], input, maxBuffer, cl::Local(localSize * sizeof(cl_int)), (cl_int)dataSize), globalSize, localSize, maxEvent);
+		kernel.executeKernel(names[2], kernel.createKernel(names[2], input, sumBuffer, cl::Local(localSize * sizeof(cl_long)), (cl_int)dataSize), globalSize, localSize, sumEvent);
+		events.insert(events.end(), { minEvent, maxEvent, sumEvent });
+
+		cl_long sumValue = kernel.readLongResult(sumBuffer, groups, localSize, events);
+		cl_int minValue = kernel.readKernelBuffer(minBuffer, sizeof(cl_int), vector<cl_int>(1))[0];
+		cl_int maxValue = kernel.readKernelBuffer(maxBuffer, sizeof(cl_int), vector<cl_int>(1))[0];
+		return to_string(minValue) + ", " + to_string(maxValue) + ", " + to_string(sumValue);
+	}
+
+	// Runs a variance kernel that finishes with a global atomic, one element per work-item
+	string runVariance(string name, cl::Buffer input, size_t dataSize, size_t globalSize, size_t localSize, int mean, vector<cl::Event>& events)
+	{
+		size_t groups = globalSize / localSize;
+		cl::Buffer buffer = kernel.createLongResults(groups);
+		cl::Event kernelEvent;
+		kernel.executeKernel(name, kernel.setupKernel(name, input, buffer, localSize * sizeof(cl_long), mean, (int)dataSize), globalSize, localSize, kernelEvent);
+		events.push_back(kernelEvent);
+		return to_string(kernel.readLongResult(buffer, groups, localSize, events));
+	}
+
+	template <typename Element, typename Accumulator>
+	static string formatStats(const Stats<Element, Accumulator>& totals)
+	{
+		return to_string(totals.min) + ", " + to_string(totals.max) + ", " + to_string(totals.sum);
+	}
+
+	// Runs the two-stage min, max and sum kernels over a given number of work-groups
+	string runTwoStage(cl::Buffer input, size_t dataSize, size_t localSize, size_t groups, vector<cl::Event>& events)
+	{
+		cl::Buffer minBuffer = kernel.reduceTwoStage("minPartial", "minPartial", input, dataSize, sizeof(cl_int), localSize, groups, events);
+		cl::Buffer maxBuffer = kernel.reduceTwoStage("maxPartial", "maxPartial", input, dataSize, sizeof(cl_int), localSize, groups, events);
+		cl::Buffer sumBuffer = kernel.reduceTwoStage("sumPartial", "sumMerge", input, dataSize, sizeof(cl_long), localSize, groups, events);
+
+		cl_int minValue = kernel.readKernelBuffer(minBuffer, sizeof(cl_int), vector<cl_int>(1))[0];
+		cl_int maxValue = kernel.readKernelBuffer(maxBuffer, sizeof(cl_int), vector<cl_int>(1))[0];
+		cl_long sumValue = kernel.readKernelBuffer(sumBuffer, sizeof(cl_long), vector<cl_long>(1))[0];
+		return to_string(minValue) + ", " + to_string(maxValue) + ", " + to_string(sumValue);
+	}
+
+	// Compares the legacy atomic kernels with the reductions that replace them, given the data, the global size of the
+	// one element per work-item kernels and the mean (multiplied by 100) for the variance kernels
+	void runReductions(cl::Buffer input, size_t dataSize, size_t globalSize, size_t localSize, int mean)
+	{
+		kernel.showProgress = false;
+		size_t groups = globalSize / localSize;
+
+		// One launch per statistic, interleaved addressing and a global atomic per work-group
+		const string interleaved[3] = { "minReduce", "maxReduce", "sumReduce" };
+		run("Interleaved min, max, sum (minReduce, maxReduce, sumReduce)", [&](vector<cl::Event>& events) {
+			return runAtomic(interleaved, input, dataSize, globalSize, localSize, events);
+		});
+
+		// The same launches with sequential addressing and an unrolled tail
+		const string sequential[3] = { "minReduceSequential", "maxReduceSequential", "sumReduceSequential" };
+		run("Sequential min, max, sum (minReduceSequential, maxReduceSequential, sumReduceSequential)", [&](vector<cl::Event>& events) {
+			return runAtomic(sequential, input, dataSize, globalSize, localSize, events);
+		});
+
+		// Variance as a sum pass, a read of the mean back to the host and a second pass, against Welford in one pass
+		run("Two-pass standard deviation (sumReduce, varianceReduce)", [&](vector<cl::Event>& events) {
+			cl::Buffer sumBuffer = kernel.createLongResults(groups);
+			cl::Event sumEvent;
+			kernel.executeKernel("sumReduce", kernel.createKernel("sumReduce", input, sumBuffer, cl::Local(localSize * sizeof(cl_long)), (cl_int)dataSize), globalSize, localSize, sumEvent);
+			events.push_back(sumEvent);
+			double twoPassMean = (double)kernel.readLongResult(sumBuffer, groups, localSize, events) / dataSize;
+
+			cl::Buffer varianceBuffer = kernel.createLongResults(groups);
+			cl::Event varianceEvent;
+			kernel.executeKernel("varianceReduce", kernel.setupKernel("varianceReduce", input, varianceBuffer, localSize * sizeof(cl_long), (int)round(twoPassMean), (int)dataSize), globalSize, localSize, varianceEvent);
+			events.push_back(varianceEvent);
+			double squares = (double)kernel.readLongResult(varianceBuffer, groups, localSize, events);
+			return to_string(sqrt(squares / dataSize) / 100);
+		});
+
+		size_t momentsGrid = kernel.gridGroups(dataSize, localSize, localSize * sizeof(Moments<cl_double>));
+		run("One-pass standard deviation over " + to_string(momentsGrid) + " work-groups (varianceWelford, momentsMerge)", [&](vector<cl::Event>& events) {
+			Moments<double> moments = kernel.reduceMoments(input, dataSize, localSize, momentsGrid, events);
+			return to_string(sqrt(moments.m2 / moments.count) / 100);
+		});
+
+		run("Interleaved variance (varianceReduce)", [&](vector<cl::Event>& events) {
+			return runVariance("varianceReduce", input, dataSize, globalSize, localSize, mean, events);
+		});
+
+		run("Sequential variance (varianceReduceSequential)", [&](vector<cl::Event>& events) {
+			return runVariance("varianceReduceSequential", input, dataSize, globalSize, localSize, mean, events);
+		});
+
+		// Two launches per statistic, partials are reduced by a second single work-group launch. With one element per
+		// work-item first, then with a grid sized to the device where each work-item reduces a strided range.
+		size_t grid = kernel.gridGroups(dataSize, localSize, localSize * sizeof(cl_long));
+		run("Two-stage min, max, sum, one element per work-item (minPartial, maxPartial, sumPartial)", [&](vector<cl::Event>& events) {
+			return runTwoStage(input, dataSize, localSize, groups, events);
+		});
+		run("Two-stage min, max, sum, grid-stride over " + to_string(grid) + " work-groups", [&](vector<cl::Event>& events) {
+			return runTwoStage(input, dataSize, localSize, grid, events);
+		});
+
+		// Every statistic from one read of the data, with scalar loads and then with the device's vector width
+		cl_uint vectorWidth = kernel.vectorWidth;
+		size_t statsScratch = kernel.statsScratchBytes(localSize);
+		size_t statsGrid = kernel.gridGroups(dataSize, localSize, statsScratch);
+		kernel.vectorWidth = 1;
+		run("Fused statistics, one element per work-item (statsReduce, statsMerge)", [&](vector<cl::Event>& events) {
+			return formatStats(kernel.reduceStats(input, dataSize, localSize, groups, events));
+		});
+		run("Fused statistics, grid-stride over " + to_string(statsGrid) + " work-groups", [&](vector<cl::Event>& events) {
+			return formatStats(kernel.reduceStats(input, dataSize, localSize, statsGrid, events));
+		});
+		kernel.vectorWidth = vectorWidth;
+		if (vectorWidth > 1)
+		{
+			size_t vectorGrid = kernel.gridGroups((dataSize + vectorWidth - 1) / vectorWidth, localSize, statsScratch);
+			run("Fused statistics, int" + to_string(vectorWidth) + " loads over " + to_string(vectorGrid) + " work-groups (statsReduceVector)", [&](vector<cl::Event>& events) {
+				return formatStats(kernel.reduceStats(input, dataSize, localSize, vectorGrid, events));
+			});
+		}
+
+		kernel.showProgress = true;
+	}
+
+	// Runs the fused statistics with the temperatures converted to another element type, using the program built for it
+	template <typename Element>
+	void runElementType(cl::Context context, cl::CommandQueue queue, const vector<int>& temperatures, size_t localSize, function<Element(int)> convert)
+	{
+		string name = "Fused statistics, " + KernelType<Element>::name() + " elements (" + to_string(temperatures.size() * sizeof(Element)) + " bytes)";
+		try
+		{
+			Kernel<Element> typed(context, queue);
+			typed.showProgress = false;
+
+			// Wide types get a smaller local size, so statsMerge's scratch fits in local memory
+			size_t typedLocalSize = typed.statsLocalSize(localSize);
+			vector<Element> values(temperatures.size());
+			transform(temperatures.begin(), temperatures.end(), values.begin(), convert);
+			cl::Buffer input = typed.createBuffer(values);
+			size_t groups = typed.gridGroups((values.size() + typed.vectorWidth - 1) / typed.vectorWidth, typedLocalSize, typed.statsScratchBytes(typedLocalSize));
+
+			run(name + ", local size " + to_string(typedLocalSize), [&](vector<cl::Event>& events) {
+				return formatStats(typed.reduceStats(input, values.size(), typedLocalSize, groups, events));
+			});
+		}
+		catch (const cl::Error& err)
+		{
+			results.push_back(failed(name, err));
+		}
+	}
+
+	// Compares the fused statistics over the temperatures (multiplied by 100) stored as 16 and 32-bit integers, and in
+	// degrees as floats and doubles (doubles only when the device supports them)
+	void runElementTypes(cl::Context context, cl::CommandQueue queue, const vector<int>& temperatures, size_t localSize)
+	{
+		runElementType<cl_short>(context, queue, temperatures, localSize, [](int value) { return (cl_short)value; });
+		runElementType<cl_int>(context, queue, temperatures, localSize, [](int value) { return (cl_int)value; });
+		runElementType<cl_float>(context, queue, temperatures, localSize, [](int value) { return value / 100.f; });
+		if (kernel.fp64)
+			runElementType<cl_double>(context, queue, temperatures, localSize, [](int value) { return value / 100.0; });
+	}
+
+	// Reads a sorted buffer back, returning its smallest, middle and largest values, or why it isn't sorted
+	string describeSorted(cl::Buffer sorted, size_t dataSize)
+	{
+		vector<mytype> values = kernel.readKernelBuffer(sorted, dataSize * sizeof(mytype), vector<mytype>(max(dataSize, (size_t)1)));
+		values.resize(dataSize);
+		if (!is_sorted(values.begin(), values.end()))
+			return "not in ascending order";
+		if (values.empty())
+			return "empty";
+		return to_string(values.front()) + ", " + to_string(values[dataSize / 2]) + ", " + to_string(values.back());
+	}
+
+	// Largest number of records selectionSort is benchmarked on, beyond it a single O(N^2) run can outlast the
+	// display driver's timeout (see the README)
+	size_t selectionSortLimit = 1 << 16;
+
+	// Compares the radix sort, the bitonic and merge sort and selectionSort over the same input, and radix select
+	void runSorts(cl::Buffer input, size_t dataSize, size_t localSize)
+	{
+		kernel.showProgress = false;
+
+		bool radix = kernel.radixSortable() && localSize >= (1 << kernel.radixBits);
+		if (radix)
+			run("Radix sort, " + to_string(kernel.radixBits) + " bits per pass (radixCount, radixScan, radixScatter)", [&](vector<cl::Event>& events) {
+				return describeSorted(kernel.radixSort(input, dataSize, localSize, events), dataSize);
+			});
+
+		if ((localSize & (localSize - 1)) == 0 && localSize >= kernel.mergeItems)
+			run("Bitonic tile sort and merge path merges (bitonicSortLocal, mergePath)", [&](vector<cl::Event>& events) {
+				return describeSorted(kernel.bitonicMergeSort(input, dataSize, localSize, events), dataSize);
+			});
+
+		if (dataSize <= selectionSortLimit)
+			run("Selection sort (selectionSort)", [&](vector<cl::Event>& events) {
+				return describeSorted(kernel.selectionSort(input, dataSize, localSize, events), dataSize);
+			});
+		else
+			results.push_back({ "Selection sort (selectionSort)", 0, "skipped, more than " + to_string(selectionSortLimit) + " records" });
+
+		// Two order statistics without sorting, for comparison with the full sorts above
+		size_t last = max(dataSize, (size_t)1) - 1;
+		if (kernel.radixSortable() && dataSize > 0)
+			run("Radix select of the median and 99th percentile, " + to_string(32 / kernel.selectBits) + " passes each (radixSelectCount)", [&](vector<cl::Event>& events) {
+				mytype median = kernel.radixSelect(input, dataSize, last / 2, localSize, events);
+				mytype p99 = kernel.radixSelect(input, dataSize, (size_t)(last * 0.99), localSize, events);
+				return to_string(median) + ", " + to_string(p99);
+			});
+
+		kernel.showProgress = true;
+	}
+
+	// Times the fixed-point temperature parser against the stof expression it replaced, per record of a text file.
+	// Also counts the records where the two disagree, which is where stof's float rounding lost a hundredth.
+	void runParsers(const string& file_url)
+	{
+		MappedFile mapped;
+		if (!mapped.open(file_url))
+		{
+			results.push_back({ "Temperature parsing", 0, "skipped, no text file" });
+			return;
+		}
+
+		// Start, last field and end of every line
+		vector<const char*> lines, fields, ends;
+		for (const char* pos = mapped.begin(); pos < mapped.end();)
+		{
+			const char* lineEnd = (const char*)memchr(pos, '\n', mapped.end() - pos);
+			if (lineEnd == nullptr)
+				lineEnd = mapped.end();
+			const char* fieldEnd = (lineEnd > pos && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd;
+			const char* field = fieldEnd;
+			while (field > pos && field[-1] != ' ')
+				field--;
+			if (field > pos)
+			{
+				lines.push_back(pos);
+				fields.push_back(field);
+				ends.push_back(fieldEnd);
+			}
+			pos = lineEnd + 1;
+		}
+		size_t count = max(lines.size(), (size_t)1);
+
+		// Fastest of a number of runs over every record
+		auto time = [&](function<int(size_t)> parse, vector<int>& values) {
+			double seconds = numeric_limits<double>::max();
+			for (size_t run = 0; run < repeats; run++)
+			{
+				auto start = chrono::steady_clock::now();
+				for (size_t i = 0; i < lines.size(); i++)
+					values[i] = parse(i);
+				seconds = min(seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+			}
+			return seconds;
+		};
+
+		vector<int> stofValues(lines.size()), fixedValues(lines.size());
+		double stofSeconds = time([&](size_t i) {
+			string line(lines[i], ends[i]);
+			return (int)(stof(line.substr(line.rfind(" "))) * 100);
+		}, stofValues);
+		double fixedSeconds = time([&](size_t i) {
+			return Parser::parseFixedPoint(fields[i], ends[i]);
+		}, fixedValues);
+
+		size_t differences = 0;
+		for (size_t i = 0; i < lines.size(); i++)
+			differences += (stofValues[i] != fixedValues[i]);
+
+		results.push_back({ "Temperature parsing, stof per line (host)", stofSeconds, to_string(stofSeconds / count * 1e9) + " ns per record" });
+		results.push_back({ "Temperature parsing, Parser::parseFixedPoint (host)", fixedSeconds,
+			to_string(fixedSeconds / count * 1e9) + " ns per record, " + to_string(differences) + " of " + to_string(lines.size()) + " records differ from stof" });
+	}
+
+	// Number of times each whole file is read, lower than repeats as a read takes far longer than a kernel
+	size_t fileRepeats = 3;
+
+	// Times reading a whole text file with the line by line reader Parser::readFile replaced (getline, substr and stof
+	// into a vector) against readFile itself with its binary cache turned off, and counts the temperatures that differ
+	void runFileReaders(const string& file_url)
+	{
+		if (!ifstream(file_url))
+		{
+			results.push_back({ "Whole file reading", 0, "skipped, no text file" });
+			return;
+		}
+
+		// Fastest of a number of reads of the file
+		auto time = [&](function<void()> read) {
+			double seconds = numeric_limits<double>::max();
+			for (size_t run = 0; run < fileRepeats; run++)
+			{
+				auto start = chrono::steady_clock::now();
+				read();
+				seconds = min(seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+			}
+			return seconds;
+		};
+
+		vector<int> lineValues;
+		bool lineFailed = false;
+		double lineSeconds = time([&]() {
+			ifstream file(file_url);
+			string line;
+			lineValues.clear();
+			try
+			{
+				while (getline(file, line))
+				{
+					if (line.empty())
+						continue;
+					int lastVal = stof(line.substr(line.rfind(" "))) * 100;
+					lineValues.push_back(lastVal);
+				}
+			}
+			catch (const exception&)
+			{
+				lineFailed = true;
+			}
+		});
+
+		Parser parser;
+		parser.showProgress = false;
+		parser.useCache = false;
+		string url = file_url;
+		Records records;
+		double parserSeconds = time([&]() {
+			records = parser.readFile(url);
+		});
+
+		string name = "Whole file reading (host, fastest of " + to_string(fileRepeats) + " reads), ";
+		if (lineFailed)
+			results.push_back({ name + "getline, substr and stof", lineSeconds, "stopped at a line without a temperature" });
+		else
+			results.push_back({ name + "getline, substr and stof", lineSeconds, to_string(lineValues.size()) + " records" });
+
+		string comparison = "records differ in number from getline";
+		if (records.size() == lineValues.size())
+		{
+			size_t differences = 0;
+			for (size_t i = 0; i < records.size(); i++)
+				differences += (records.temperature[i] != lineValues[i]);
+			comparison = to_string(differences) + " temperatures differ from getline";
+		}
+		results.push_back({ name + "Parser::readFile without cache, " + to_string(parser.threadCount) + " thread(s)", parserSeconds,
+			to_string(records.size()) + " records, " + to_string(lineSeconds / parserSeconds) + "x the speed of getline, " + comparison });
+	}
+
+	// Outputs the fastest time and result of every variant
+	void outputResults()
+	{
+		cout << "\nBenchmark results (fastest of " << repeats << " runs):" << endl;
+		for (const Result& result : results)
+		{
+			cout << "  " << result.name << endl;
+			cout << "     " << fixed << setprecision(9) << result.seconds << " [secs], result: " << result.value << endl;
+		}
+		cout << endl;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "MappedFile.hpp"
+
+// Text dataset stored as independently compressed frames, so frames can be decompressed and parsed in parallel.
+// Layout: header, one index entry per frame, then the frames. Every frame ends on a line boundary and is encoded
+// in the LZ4 block format.
+class BlockArchive
+{
+	static const uint32_t version = 1;
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t frameCount;
+		uint64_t rawSize;
+		uint64_t lineCount;
+	};
+
+	struct Frame
+	{
+		uint64_t offset; // from the start of the file
+		uint32_t compressedSize;
+		uint32_t rawSize;
+		uint64_t lineCount;
+	};
+
+	static const char* magic() { return "WXZ1"; }
+
+	MappedFile mapped;
+	Header header = {};
+	vector<Frame> frames;
+
+	static uint32_t read32(const char* bytes)
+	{
+		uint32_t value;
+		memcpy(&value, bytes, 4);
+		return value;
+	}
+
+	// Writes a length above 15 as a run of extra bytes, following an LZ4 token
+	static void writeLength(vector<char>& out, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			out.push_back((char)255);
+		out.push_back((char)length);
+	}
+
+	// Compresses a block into LZ4 sequences with a greedy single-probe hash table match finder
+	static void compressBlock(const char* source, size_t length, vector<char>& out)
+	{
+		const size_t hashBits = 16;
+		vector<int> table((size_t)1 << hashBits, -1);
+
+		size_t anchor = 0;
+		size_t pos = 0;
+
+		// The format requires the final 5 bytes to be literals and the last match to start 12 bytes before the end
+		size_t matchLimit = (length > 12) ? length - 12 : 0;
+		while (pos < matchLimit)
+		{
+			uint32_t sequence = read32(source + pos);
+			size_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+			int candidate = table[hash];
+			table[hash] = (int)pos;
+
+			if (candidate < 0 || pos - candidate > 65535 || read32(source + candidate) != sequence)
+			{
+				pos++;
+				continue;
+			}
+
+			size_t matchLength = 4;
+			while (pos + matchLength < length - 5 && source[candidate + matchLength] == source[pos + matchLength])
+				matchLength++;
+
+			// Token, literals, offset, then any extra match length
+			size_t literalLength = pos - anchor;
+			out.push_back((char)((min(literalLength, (size_t)15) << 4) | min(matchLength - 4, (size_t)15)));
+			if (literalLength >= 15)
+				writeLength(out, literalLength - 15);
+			out.insert(out.end(), source + anchor, source + pos);
+
+			size_t offset = pos - candidate;
+			out.push_back((char)(offset & 0xFF));
+			out.push_back((char)(offset >> 8));
+			if (matchLength - 4 >= 15)
+				writeLength(out, matchLength - 4 - 15);
+
+			pos += matchLength;
+			anchor = pos;
+		}
+
+		// Remaining bytes as a final literal-only sequence
+		size_t literalLength = length - anchor;
+		out.push_back((char)(min(literalLength, (size_t)15) << 4));
+		if (literalLength >= 15)
+			writeLength(out, literalLength - 15);
+		out.insert(out.end(), source + anchor, source + length);
+	}
+
+	// Decodes LZ4 sequences into a buffer of the expected size, returns false if the block is malformed
+	static bool decompressBlock(const char* source, size_t length, char* out, size_t outLength)
+	{
+		const unsigned char* in = (const unsigned char*)source;
+		const unsigned char* inEnd = in + length;
+		size_t outPos = 0;
+
+		while (in < inEnd)
+		{
+			unsigned token = *in++;
+
+			// Literals
+			size_t literalLength = token >> 4;
+			if (literalLength == 15)
+			{
+				unsigned extra;
+				do {
+					if (in >= inEnd)
+						return false;
+					extra = *in++;
+					literalLength += extra;
+				} while (extra == 255);
+			}
+			if (literalLength > (size_t)(inEnd - in) || literalLength > outLength - outPos)
+				return false;
+			memcpy(out + outPos, in, literalLength);
+			in += literalLength;
+			outPos += literalLength;
+
+			// The last sequence has no match
+			if (in == inEnd)
+				break;
+
+			// Match, which may overlap the bytes it is copying
+			if (inEnd - in < 2)
+				return false;
+			size_t offset = in[0] | (in[1] << 8);
+			in += 2;
+			if (offset == 0 || offset > outPos)
+				return false;
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15)
+			{
+				unsigned extra;
+				do {
+					if (in >= inEnd)
+						return false;
+					extra = *in++;
+					matchLength += extra;
+				} while (extra == 255);
+			}
+			matchLength += 4;
+			if (matchLength > outLength - outPos)
+				return false;
+
+			for (size_t i = 0; i < matchLength; i++, outPos++)
+				out[outPos] = out[outPos - offset];
+		}
+		return outPos == outLength;
+	}
+
+public:
+	// Extension added to a text file name for its compressed copy
+	static const char* extension() { return ".wxz"; }
+
+	// Compresses a text file into an archive, splitting it into frames of roughly the given size at line boundaries
+	static bool compressFile(const string& file_url, const string& archive_url, size_t frameBytes = 1 << 22)
+	{
+		MappedFile source;
+		if (!source.open(file_url))
+			return false;
+
+		vector<Frame> index;
+		vector<vector<char>> blocks;
+		const char* pos = source.begin();
+		while (pos < source.end())
+		{
+			const char* frameEnd = pos + min(frameBytes, (size_t)(source.end() - pos));
+			if (frameEnd < source.end())
+			{
+				const char* lineEnd = (const char*)memchr(frameEnd, '\n', source.end() - frameEnd);
+				frameEnd = (lineEnd == nullptr) ? source.end() : lineEnd + 1;
+			}
+
+			Frame frame = {};
+			frame.rawSize = (uint32_t)(frameEnd - pos);
+			for (const char* c = pos; (c = (const char*)memchr(c, '\n', frameEnd - c)) != nullptr; c++)
+				frame.lineCount++;
+			if (frameEnd == source.end() && frameEnd[-1] != '\n')
+				frame.lineCount++;
+
+			blocks.emplace_back();
+			compressBlock(pos, frameEnd - pos, blocks.back());
+			frame.compressedSize = (uint32_t)blocks.back().size();
+			index.push_back(frame);
+			pos = frameEnd;
+		}
+
+		Header archiveHeader = {};
+		memcpy(archiveHeader.magic, magic(), sizeof(archiveHeader.magic));
+		archiveHeader.version = version;
+		archiveHeader.frameCount = index.size();
+		archiveHeader.rawSize = source.size();
+
+		uint64_t offset = sizeof(Header) + index.size() * sizeof(Frame);
+		for (Frame& frame : index)
+		{
+			frame.offset = offset;
+			offset += frame.compressedSize;
+			archiveHeader.lineCount += frame.lineCount;
+		}
+
+		ofstream file(archive_url, ios::binary | ios::trunc);
+		if (!file.is_open())
+			return false;
+		file.write((const char*)&archiveHeader, sizeof(Header));
+		file.write((const char*)index.data(), index.size() * sizeof(Frame));
+		for (const vector<char>& block : blocks)
+			file.write(block.data(), block.size());
+		file.close();
+		return !file.fail();
+	}
+
+	// Maps an archive and reads its index, returns false if it is missing or malformed
+	bool open(const string& archive_url)
+	{
+		frames.clear();
+		if (!mapped.open(archive_url) || mapped.size() < sizeof(Header))
+			return false;
+
+		memcpy(&header, mapped.begin(), sizeof(Header));
+		if (memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != version)
+			return false;
+		if (header.frameCount > (mapped.size() - sizeof(Header)) / sizeof(Frame))
+			return false;
+
+		frames.resize((size_t)header.frameCount);
+		memcpy(frames.data(), mapped.begin() + sizeof(Header), frames.size() * sizeof(Frame));
+		uint64_t lines = 0;
+		for (const Frame& frame : frames)
+		{
+			if (frame.offset + frame.compressedSize > mapped.size())
+				return false;
+			lines += frame.lineCount;
+		}
+
+		// Readers size their buffers from the line counts, so the frames must agree with the header
+		return lines == header.lineCount;
+	}
+
+	size_t frameCount() const { return frames.size(); }
+	size_t lineCount() const { return (size_t)header.lineCount; }
+	size_t frameLineCount(size_t index) const { return (size_t)frames[index].lineCount; }
+	size_t rawSize() const { return (size_t)header.rawSize; }
+	size_t compressedSize() const { return mapped.size(); }
+
+	// Decompresses one frame into the given buffer, returns false if the frame is corrupt
+	bool decompressFrame(size_t index, vector<char>& out) const
+	{
+		const Frame& frame = frames[index];
+		out.resize(frame.rawSize);
+		return decompressBlock(mapped.begin() + frame.offset, frame.compressedSize, out.data(), out.size());
+	}
+};
\ No newline at end of file
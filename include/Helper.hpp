@@ -4,6 +4,7 @@
 #include <string>
 #include <limits>
 
+#include "Percentiles.hpp"
 #include "Utils.h"
 
 using namespace std;
@@ -94,6 +95,7 @@ public:
 	string consoleInput;
 	int platform_id = 0;
 	int device_id = 0;
+	bool benchmarkFlag = false; // time the alternative reductions, sorts, radix select, element types and parsers after calculating statistics
 
 	// Displays the help menu
 	void printHelp() {
@@ -103,7 +105,8 @@ public:
 		cout << "-----------------------------------------------------------------" << endl;
 		cout << "  1 : list and select platforms and devices" << endl;
 		cout << "  2 : calculate statistics (uses selected platform and device)" << endl;
-		cout << "  3 : exit program" << endl;
+		cout << "  3 : benchmark reductions, sorts, radix select, element types and parsers (uses selected platform and device)" << endl;
+		cout << "  4 : exit program" << endl;
 		cout << "-----------------------------------------------------------------" << endl;
 	};
 
@@ -162,16 +165,21 @@ public:
 						system("CLS");
 						break;
 					case(3):
+						benchmarkFlag = true;
+						startProgram = true; // begin program
+						system("CLS");
+						break;
+					case(4):
 						exit(0);
 						break;
 					default:
-						cerr << "Command number doesn't exist! Input a number between '1' and '3'." << endl;
+						cerr << "Command number doesn't exist! Input a number between '1' and '4'." << endl;
 						break;
 					}
 				}
 			}
 			catch (std::exception& err) {
-				cerr << "Invalid entry. Input a number between '1' and '3'." << endl;
+				cerr << "Invalid entry. Input a number between '1' and '4'." << endl;
 			}
 		}
 	};
@@ -221,6 +229,15 @@ public:
 		cout << "|" << endl;
 	}
 
+	// Output the value at each percentile and the rule used between ranks
+	void outputPercentiles(const vector<double>& percentiles, const vector<double>& values, Interpolation rule)
+	{
+		cout << "Percentiles (" << interpolationName(rule) << " interpolation):" << endl;
+		for (int i = 0; i < percentiles.size(); i++)
+			cout << "  p" << defaultfloat << setprecision(6) << percentiles[i] << ": " << fixed << setprecision(3) << values[i] << endl;
+		cout << endl;
+	}
+
 	// Outputs the statistics and kernel information at the end of the program
 	void outputInfo(vector<float>& statistics, vector<string>& kernel_names, vector<cl::Event>& kernel_events, bool sortFlag)
 	{
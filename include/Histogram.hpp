@@ -0,0 +1,23 @@
+#pragma once
+#include "Utils.h"
+
+// Number of times each whole value between a minimum and maximum appears in a dataset. Gives the exact value at any
+// rank of the sorted data with a prefix walk over the bins, without sorting the data itself.
+struct Histogram
+{
+	cl_int minValue = 0;
+	vector<cl_uint> counts; // counts[i] is the number of values equal to minValue + i
+
+	// Returns the value at a rank of the sorted data, where 0 is the smallest value
+	cl_int valueAt(size_t rank) const
+	{
+		size_t seen = 0;
+		for (size_t i = 0; i < counts.size(); i++)
+		{
+			seen += counts[i];
+			if (rank < seen)
+				return minValue + (cl_int)i;
+		}
+		return minValue + (cl_int)counts.size() - 1;
+	}
+};
\ No newline at end of file
@@ -1,8 +1,108 @@
 #pragma once
 #include "Helper.hpp"
+#include "Histogram.hpp"
+#include "Percentiles.hpp"
+#include "ProgramCache.hpp"
+#include "Records.hpp"
 
 typedef int mytype;
 
+// The temperature column is uploaded to the device as it is, so the device element type must match the host column.
+// Compact types such as cl_short are converted from the column first, as Benchmark::runElementType does.
+static_assert(is_same<mytype, Records::Temperature>::value, "mytype must match the type of Records::temperature");
+
+// OpenCL C name, identity values and default accumulator of each element type the kernels can be built for
+template <typename Element>
+struct KernelType;
+
+template <>
+struct KernelType<cl_short>
+{
+	typedef cl_long accumulator;
+	static string name() { return "short"; }
+	static string minValue() { return "SHRT_MIN"; }
+	static string maxValue() { return "SHRT_MAX"; }
+	static cl_uint preferredWidth(const cl::Device& device) { return device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT>(); }
+};
+
+template <>
+struct KernelType<cl_int>
+{
+	typedef cl_long accumulator;
+	static string name() { return "int"; }
+	static string minValue() { return "INT_MIN"; }
+	static string maxValue() { return "INT_MAX"; }
+	static cl_uint preferredWidth(const cl::Device& device) { return device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT>(); }
+};
+
+template <>
+struct KernelType<cl_long>
+{
+	typedef cl_long accumulator;
+	static string name() { return "long"; }
+	static string minValue() { return "LONG_MIN"; }
+	static string maxValue() { return "LONG_MAX"; }
+	static cl_uint preferredWidth(const cl::Device& device) { return device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG>(); }
+};
+
+// Floats are summed as floats by default, as double precision is optional on devices
+template <>
+struct KernelType<cl_float>
+{
+	typedef cl_float accumulator;
+	static string name() { return "float"; }
+	static string minValue() { return "-INFINITY"; }
+	static string maxValue() { return "INFINITY"; }
+	static cl_uint preferredWidth(const cl::Device& device) { return device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>(); }
+};
+
+template <>
+struct KernelType<cl_double>
+{
+	typedef cl_double accumulator;
+	static string name() { return "double"; }
+	static string minValue() { return "-INFINITY"; }
+	static string maxValue() { return "INFINITY"; }
+	static cl_uint preferredWidth(const cl::Device& device) { return device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE>(); }
+};
+
+// Partial statistics written by the statsReduce kernel, matches the Stats struct in my_kernels.cl
+template <typename Element, typename Accumulator>
+struct Stats
+{
+	Accumulator sum;
+	Accumulator sumSquares;
+	Element min;
+	Element max;
+	cl_int count;
+	cl_int padding;
+};
+
+// Count, mean and sum of squared differences from the mean (M2) written by varianceWelford, matches the Moments struct
+// in my_kernels.cl, where T is double when the program is built with USE_FP64 and float otherwise
+template <typename T>
+struct Moments
+{
+	cl_int count;
+	cl_int padding;
+	T mean;
+	T m2;
+};
+
+// Device copies of a set of records, one buffer per column
+struct RecordBuffers
+{
+	cl::Buffer station;
+	cl::Buffer year;
+	cl::Buffer month;
+	cl::Buffer day;
+	cl::Buffer time;
+	cl::Buffer timestamp;
+	cl::Buffer temperature;
+};
+
+// Creates and runs the kernels of my_kernels.cl, built for an element type and the type its sums accumulate in
+template <typename Element = mytype, typename Accumulator = typename KernelType<Element>::accumulator>
 class Kernel
 {
 protected:
@@ -11,12 +111,107 @@ protected:
 	cl::Program program;
 
 public:
-	// Sets a kernel instance with a stored context, queue and program
-	Kernel(cl::Context _context, cl::CommandQueue _queue, cl::Program _program)
+	typedef ::Stats<Element, Accumulator> Stats;
+
+	// Options the program was built with
+	string buildOptions;
+
+	// Prints each kernel name as it is queued, turned off for repeated benchmark runs
+	bool showProgress = true;
+
+	// Values the statistics kernel loads at a time, built into the program as VECTOR_WIDTH. 1 uses the scalar statsReduce.
+	cl_uint vectorWidth = 1;
+
+	// Returns the vector width for a device's preferred width of the element type, rounded down to a width OpenCL has vectors for (2 to 16)
+	static cl_uint preferredVectorWidth(const cl::Device& device)
+	{
+		cl_uint preferred = KernelType<Element>::preferredWidth(device);
+		cl_uint width = 1;
+		while (width < 16 && width * 2 <= preferred)
+			width *= 2;
+		return width;
+	}
+
+	// Returns the build options for the fastest work-group reduction the device supports: the OpenCL C 2.x work-group
+	// built-ins, Intel sub-group built-ins, or none for the local memory tree every OpenCL 1.2 device can run
+	static string reductionOptions(const cl::Device& device)
+	{
+		// Reported as "OpenCL C <major>.<minor> ..."
+		string version = device.getInfo<CL_DEVICE_OPENCL_C_VERSION>();
+		int major = (version.size() > 9) ? version[9] - '0' : 1;
+		if (major == 2)
+			return "-cl-std=CL2.0 -D USE_WORK_GROUP_BUILTINS";
+		if (device.getInfo<CL_DEVICE_EXTENSIONS>().find("cl_intel_subgroups") != string::npos)
+			return "-D USE_SUB_GROUP_BUILTINS";
+		return "";
+	}
+
+	// Name of the kernel used for the first stage of the statistics
+	string statsKernelName()
+	{
+		return (vectorWidth > 1) ? "statsReduceVector" : "statsReduce";
+	}
+
+	// Whether the device can add 64-bit values atomically, which sumReduce and varianceReduce use when it can.
+	// Passed to the program as USE_INT64_ATOMICS, so the kernels and the host size the results the same way.
+	bool int64Atomics = false;
+
+	// Whether the device has double precision, which varianceWelford uses for its moments when it can.
+	// Passed to the program as USE_FP64, so the kernels and the host agree on the layout of the moments.
+	bool fp64 = false;
+
+	// Sets a kernel instance with a stored context and queue, and the program built for its types and device.
+	// Programs are cached, so instances with the same types and options share one build.
+	Kernel(cl::Context _context, cl::CommandQueue _queue, string options = "")
 	{
 		context = _context;
 		queue = _queue;
-		program = _program;
+
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		string extensions = device.getInfo<CL_DEVICE_EXTENSIONS>();
+		int64Atomics = extensions.find("cl_khr_int64_base_atomics") != string::npos;
+		fp64 = extensions.find("cl_khr_fp64") != string::npos;
+
+		// Load the data as the widest vectors the device prefers, and reduce work-groups with built-ins where supported
+		vectorWidth = preferredVectorWidth(device);
+		buildOptions = "-D T=" + KernelType<Element>::name() + " -D T_MIN=" + KernelType<Element>::minValue()
+			+ " -D T_MAX=" + KernelType<Element>::maxValue() + " -D ACC=" + KernelType<Accumulator>::name();
+		if (vectorWidth > 1)
+			buildOptions += " -D VECTOR_WIDTH=" + to_string(vectorWidth);
+		if (int64Atomics)
+			buildOptions += " -D USE_INT64_ATOMICS";
+		if (fp64)
+			buildOptions += " -D USE_FP64";
+		string reduction = reductionOptions(device);
+		if (!reduction.empty())
+			buildOptions += " " + reduction;
+		if (!options.empty())
+			buildOptions += " " + options;
+		program = ProgramCache::get(context, "kernels/my_kernels.cl", buildOptions);
+	}
+
+	// Local memory the statistics need for each work-group, statsMerge's extra counts make it the larger of the two launches
+	static size_t statsScratchBytes(size_t localSize)
+	{
+		return localSize * (2 * (sizeof(Element) + sizeof(Accumulator)) + sizeof(cl_int));
+	}
+
+	// Largest power of two local size up to the requested one that the device accepts, and whose work-groups fit in local
+	// memory when each work-item needs the given number of bytes of it
+	size_t fitLocalSize(size_t localSize, size_t bytesPerItem)
+	{
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		size_t localMemory = (size_t)device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+		size_t maxLocalSize = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+		while (localSize > 1 && (localSize > maxLocalSize || localSize * bytesPerItem > localMemory))
+			localSize /= 2;
+		return localSize;
+	}
+
+	// Local size for reduceStats, shrunk from the requested one for wide element and accumulator types
+	size_t statsLocalSize(size_t localSize)
+	{
+		return fitLocalSize(localSize, statsScratchBytes(1));
 	}
 
 	// Creates a buffer and fills it with zeros
@@ -27,6 +222,61 @@ public:
 		return buffer;
 	}
 
+	// Creates a buffer of a number of elements, each set to the given value
+	template <typename T>
+	cl::Buffer createBuffer(size_t count, T value)
+	{
+		cl::Buffer buffer(context, CL_MEM_READ_WRITE, count * sizeof(T));
+		queue.enqueueFillBuffer(buffer, value, 0, count * sizeof(T));
+		return buffer;
+	}
+
+	// Creates a read only buffer holding a copy of the given vector
+	template <typename T>
+	cl::Buffer createBuffer(const vector<T>& values)
+	{
+		size_t size = values.size() * sizeof(T);
+		cl::Buffer buffer(context, CL_MEM_READ_ONLY, size);
+		queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, size, values.data());
+		return buffer;
+	}
+
+	// Starts copying rows of a vector into the same rows of a device buffer without waiting for it to finish,
+	// the vector must stay in place until the returned event has completed
+	template <typename T>
+	cl::Event writeBufferAsync(cl::Buffer& buffer, const vector<T>& values, size_t firstRow, size_t rowCount)
+	{
+		cl::Event writeEvent;
+		queue.enqueueWriteBuffer(buffer, CL_FALSE, firstRow * sizeof(T), rowCount * sizeof(T), &values[firstRow], NULL, &writeEvent);
+		queue.flush(); // Start the transfer straight away
+		return writeEvent;
+	}
+
+	// Copies every column of a set of records to its own device buffer
+	RecordBuffers uploadRecords(const Records& records)
+	{
+		RecordBuffers buffers;
+		buffers.station = createBuffer(records.station);
+		buffers.year = createBuffer(records.year);
+		buffers.month = createBuffer(records.month);
+		buffers.day = createBuffer(records.day);
+		buffers.time = createBuffer(records.time);
+		buffers.timestamp = createBuffer(records.timestamp);
+		buffers.temperature = createBuffer(records.temperature);
+		return buffers;
+	}
+
+	// Creates a kernel and sets any number of arguments in order, local memory is passed as cl::Local(size)
+	template <typename... Args>
+	cl::Kernel createKernel(string kernelName, Args... args)
+	{
+		cl::Kernel kernel = cl::Kernel(program, kernelName.c_str());
+		cl_uint index = 0;
+		int expand[] = { 0, (kernel.setArg(index++, args), 0)... };
+		(void)expand;
+		return kernel;
+	}
+
 	// Creates a kernel and sets its two arguments, both as buffers
 	cl::Kernel setupKernel(string kernelName, cl::Buffer input, cl::Buffer output)
 	{
@@ -70,20 +320,410 @@ public:
 	// Executes the give kernel with the specified parameters
 	void executeKernel(string kernelName, cl::Kernel activeKernel, size_t dataSize, size_t localSize, cl::Event& kernelEvent)
 	{
-		cout << "  " << kernelName << "...";
+		if (showProgress)
+			cout << "  " << kernelName << "...";
 		if (localSize != NULL)
 			queue.enqueueNDRangeKernel(activeKernel, cl::NullRange, cl::NDRange(dataSize), cl::NDRange(localSize), NULL, &kernelEvent);
 		else
 			queue.enqueueNDRangeKernel(activeKernel, cl::NullRange, cl::NDRange(dataSize), cl::NullRange, NULL, &kernelEvent);
-		cout << " Complete." << endl;
+		if (showProgress)
+			cout << " Complete." << endl;
+	}
+
+	// Number of work-groups for a grid-stride kernel: enough to keep every compute unit busy, limited by how many
+	// work-groups fit in a compute unit's local memory, and never more than the data needs
+	size_t gridGroups(size_t dataSize, size_t localSize, size_t scratchBytes)
+	{
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		size_t computeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+		size_t resident = (size_t)device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>() / max(scratchBytes, (size_t)1);
+		size_t groupsPerUnit = min(max(resident, (size_t)1), (size_t)8);
+		size_t dataGroups = (dataSize + localSize - 1) / localSize;
+		return max(min(computeUnits * groupsPerUnit, dataGroups), (size_t)1);
+	}
+
+	// Runs a reduction in two launches without atomics. The first kernel writes one partial per work-group, then the
+	// second kernel reduces the partials with a single work-group. Returns a buffer holding the result as its first element.
+	cl::Buffer reduceTwoStage(string firstKernel, string secondKernel, cl::Buffer input, size_t dataSize, size_t partialSize, size_t localSize, size_t groups, vector<cl::Event>& kernelEvents)
+	{
+		cl::Buffer partials(context, CL_MEM_READ_WRITE, groups * partialSize);
+		cl::Buffer result(context, CL_MEM_READ_WRITE, partialSize);
+		cl::Event firstEvent, secondEvent;
+
+		cl::Kernel first = createKernel(firstKernel, input, partials, cl::Local(localSize * partialSize), (cl_int)dataSize);
+		executeKernel(firstKernel, first, groups * localSize, localSize, firstEvent);
+
+		cl::Kernel second = createKernel(secondKernel, partials, result, cl::Local(localSize * partialSize), (cl_int)groups);
+		executeKernel(secondKernel, second, localSize, localSize, secondEvent);
+
+		kernelEvents.push_back(firstEvent);
+		kernelEvents.push_back(secondEvent);
+		return result;
+	}
+
+	// Creates the zeroed results buffer of a 64-bit atomic reduction: one value when the device has 64-bit atomics,
+	// otherwise one partial per work-group
+	cl::Buffer createLongResults(size_t groups)
+	{
+		return createBuffer<cl_long>(int64Atomics ? 1 : groups, 0);
+	}
+
+	// Reads the result of a 64-bit atomic reduction, reducing the work-group partials with sumMerge first if needed
+	cl_long readLongResult(cl::Buffer results, size_t groups, size_t localSize, vector<cl::Event>& kernelEvents)
+	{
+		if (!int64Atomics)
+		{
+			cl::Buffer total(context, CL_MEM_READ_WRITE, sizeof(cl_long));
+			cl::Event mergeEvent;
+			cl::Kernel merge = createKernel("sumMerge", results, total, cl::Local(localSize * sizeof(cl_long)), (cl_int)groups);
+			executeKernel("sumMerge", merge, localSize, localSize, mergeEvent);
+			kernelEvents.push_back(mergeEvent);
+			results = total;
+		}
+		return readKernelBuffer(results, sizeof(cl_long), vector<cl_long>(1))[0];
+	}
+
+	// Calculates min, max, sum and sum of squares in one pass over the data, merging the work-group partials on the device.
+	// With a vector width above 1 the groups only need to cover the data divided by the width.
+	Stats reduceStats(cl::Buffer input, size_t dataSize, size_t localSize, size_t groups, vector<cl::Event>& kernelEvents)
+	{
+		cl::Buffer partials(context, CL_MEM_READ_WRITE, groups * sizeof(Stats));
+		cl::Buffer result(context, CL_MEM_READ_WRITE, sizeof(Stats));
+		cl::Event reduceEvent, mergeEvent;
+
+		cl::Kernel reduce = createKernel(statsKernelName(), input, partials,
+			cl::Local(localSize * sizeof(Element)), cl::Local(localSize * sizeof(Element)),
+			cl::Local(localSize * sizeof(Accumulator)), cl::Local(localSize * sizeof(Accumulator)), (cl_int)dataSize);
+		executeKernel(statsKernelName(), reduce, groups * localSize, localSize, reduceEvent);
+
+		cl::Kernel merge = createKernel("statsMerge", partials, result,
+			cl::Local(localSize * sizeof(Element)), cl::Local(localSize * sizeof(Element)),
+			cl::Local(localSize * sizeof(Accumulator)), cl::Local(localSize * sizeof(Accumulator)),
+			cl::Local(localSize * sizeof(cl_int)), (cl_int)groups);
+		executeKernel("statsMerge", merge, localSize, localSize, mergeEvent);
+
+		kernelEvents.push_back(reduceEvent);
+		kernelEvents.push_back(mergeEvent);
+		return readKernelBuffer(result, sizeof(Stats), vector<Stats>(1))[0];
+	}
+
+	// Calculates the count, mean and M2 of the data in one pass, merging the work-group partials on the device
+	Moments<double> reduceMoments(cl::Buffer input, size_t dataSize, size_t localSize, size_t groups, vector<cl::Event>& kernelEvents)
+	{
+		if (fp64)
+			return reduceMoments<cl_double>(input, dataSize, localSize, groups, kernelEvents);
+		return reduceMoments<cl_float>(input, dataSize, localSize, groups, kernelEvents);
+	}
+
+	// Largest number of bins the quantile histogram is built with, 256 KB of counts
+	static const size_t maxHistogramBins = 1 << 16;
+
+	// Whether the quantiles of whole values between min and max can be read from a histogram instead of a sort
+	static bool histogramFits(cl_long minValue, cl_long maxValue)
+	{
+		return is_integral<Element>::value && maxValue >= minValue && (size_t)(maxValue - minValue) < maxHistogramBins;
+	}
+
+	// Name of the kernel histogram uses for the given number of bins, counting in local memory when the bins fit
+	string histogramKernelName(size_t binCount)
+	{
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		return (binCount * sizeof(cl_uint) <= device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>()) ? "histogramLocal" : "histogramGlobal";
+	}
+
+	// Counts every value between minValue and maxValue in one pass over the data, see histogramFits
+	Histogram histogram(cl::Buffer input, size_t dataSize, cl_int minValue, cl_int maxValue, size_t localSize, vector<cl::Event>& kernelEvents)
+	{
+		size_t binCount = (size_t)maxValue - minValue + 1;
+		string kernelName = histogramKernelName(binCount);
+		cl::Buffer bins = createBuffer<cl_uint>(binCount, 0);
+		cl::Event histogramEvent;
+
+		cl::Kernel count;
+		size_t groups;
+		if (kernelName == "histogramLocal")
+		{
+			groups = gridGroups(dataSize, localSize, binCount * sizeof(cl_uint));
+			count = createKernel(kernelName, input, bins, cl::Local(binCount * sizeof(cl_uint)), minValue, (cl_int)binCount, (cl_int)dataSize);
+		}
+		else
+		{
+			groups = gridGroups(dataSize, localSize, 0);
+			count = createKernel(kernelName, input, bins, minValue, (cl_int)dataSize);
+		}
+		executeKernel(kernelName, count, groups * localSize, localSize, histogramEvent);
+		kernelEvents.push_back(histogramEvent);
+
+		Histogram result;
+		result.minValue = minValue;
+		result.counts = readKernelBuffer(bins, binCount * sizeof(cl_uint), vector<cl_uint>(binCount));
+		return result;
+	}
+
+	// Bits of the key radixSort sorts per pass, matching RADIX_BITS in the kernels
+	static const int radixBits = 4;
+
+	// Whether radixSort can sort the element type, integers of up to 32 bits
+	static bool radixSortable()
+	{
+		return is_integral<Element>::value && sizeof(Element) <= sizeof(cl_int);
+	}
+
+	// Sorts the data into ascending order with an LSD radix sort. Each pass counts the digits of every tile, scans the
+	// counts and scatters the keys, so the work grows linearly with the data. Returns a buffer holding the sorted data.
+	cl::Buffer radixSort(cl::Buffer input, size_t dataSize, size_t localSize, vector<cl::Event>& kernelEvents)
+	{
+		// radixCount and radixScatter keep one local entry per digit, written by the first RADIX_BUCKETS work-items
+		if (!radixSortable())
+			throw cl::Error(CL_INVALID_OPERATION, "radixSort: the element type is not an integer of up to 32 bits");
+		if (localSize < (1 << radixBits))
+			throw cl::Error(CL_INVALID_WORK_GROUP_SIZE, "radixSort: the local size is smaller than the number of digits");
+
+		size_t groups = max((dataSize + localSize - 1) / localSize, (size_t)1);
+		size_t countSize = groups * (1 << radixBits);
+		cl::Buffer counts(context, CL_MEM_READ_WRITE, countSize * sizeof(cl_uint));
+		cl::Buffer sorted[2] = {
+			cl::Buffer(context, CL_MEM_READ_WRITE, max(dataSize, (size_t)1) * sizeof(Element)),
+			cl::Buffer(context, CL_MEM_READ_WRITE, max(dataSize, (size_t)1) * sizeof(Element))
+		};
+
+		// Each pass reads the previous pass's output, the input buffer is left unchanged
+		cl::Buffer keys = input;
+		for (int pass = 0, shift = 0; shift < 32; pass++, shift += radixBits)
+		{
+			cl::Event countEvent, scanEvent, scatterEvent;
+
+			cl::Kernel count = createKernel("radixCount", keys, counts, cl::Local((1 << radixBits) * sizeof(cl_uint)), (cl_int)shift, (cl_int)dataSize);
+			executeKernel("radixCount", count, groups * localSize, localSize, countEvent);
+
+			cl::Kernel scan = createKernel("radixScan", counts, cl::Local(localSize * sizeof(cl_uint)), (cl_int)countSize);
+			executeKernel("radixScan", scan, localSize, localSize, scanEvent);
+
+			cl::Kernel scatter = createKernel("radixScatter", keys, sorted[pass % 2], counts, cl::Local(localSize * sizeof(Element)),
+				cl::Local(localSize * sizeof(cl_uint)), cl::Local(localSize * sizeof(cl_uint)), (cl_int)shift, (cl_int)dataSize);
+			executeKernel("radixScatter", scatter, groups * localSize, localSize, scatterEvent);
+
+			kernelEvents.insert(kernelEvents.end(), { countEvent, scanEvent, scatterEvent });
+			keys = sorted[pass % 2];
+		}
+		return keys;
+	}
+
+	// Bits of the key radixSelect chooses per pass, matching SELECT_BITS in the kernels
+	static const int selectBits = 8;
+
+	// Finds the value at a rank of the sorted data, where 0 is the smallest value, without sorting. Each pass counts the
+	// next selectBits of the keys that share the bits chosen so far in buckets, then keeps the bucket holding the rank,
+	// so it takes 32 / selectBits reads of the data and works for any range of values. Integer elements only, as radixSort.
+	Element radixSelect(cl::Buffer input, size_t dataSize, size_t rank, size_t localSize, vector<cl::Event>& kernelEvents)
+	{
+		// Keys are the bit patterns of integers, and a rank past the data would fall through to the last bucket every pass
+		if (!radixSortable())
+			throw cl::Error(CL_INVALID_OPERATION, "radixSelect: the element type is not an integer of up to 32 bits");
+		if (rank >= dataSize)
+			throw cl::Error(CL_INVALID_VALUE, "radixSelect: the rank is outside the data");
+
+		const size_t buckets = 1 << selectBits;
+		size_t groups = gridGroups(dataSize, localSize, buckets * sizeof(cl_uint));
+		cl_uint prefix = 0, prefixMask = 0;
+
+		for (int shift = 32 - selectBits; shift >= 0; shift -= selectBits)
+		{
+			cl::Buffer bins = createBuffer<cl_uint>(buckets, 0);
+			cl::Event countEvent;
+			cl::Kernel count = createKernel("radixSelectCount", input, bins, cl::Local(buckets * sizeof(cl_uint)), prefix, prefixMask, (cl_int)shift, (cl_int)dataSize);
+			executeKernel("radixSelectCount", count, groups * localSize, localSize, countEvent);
+			kernelEvents.push_back(countEvent);
+
+			// Keep the bucket holding the rank, which becomes a rank within that bucket
+			vector<cl_uint> counts = readKernelBuffer(bins, buckets * sizeof(cl_uint), vector<cl_uint>(buckets));
+			cl_uint bucket = 0;
+			while (bucket < buckets - 1 && rank >= counts[bucket])
+				rank -= counts[bucket++];
+			prefix |= bucket << shift;
+			prefixMask |= (cl_uint)(buckets - 1) << shift;
+		}
+
+		// Undo the sign bit flip of the keys
+		return (Element)(cl_int)(prefix ^ 0x80000000u);
+	}
+
+	// Sorts the data into ascending order with selectionSort, where every work-item compares its value against all of the
+	// data. Returns a buffer holding the sorted data.
+	cl::Buffer selectionSort(cl::Buffer input, size_t dataSize, size_t localSize, vector<cl::Event>& kernelEvents)
+	{
+		size_t globalSize = max((dataSize + localSize - 1) / localSize, (size_t)1) * localSize;
+		size_t vectorSize = dataSize * sizeof(Element);
+		cl::Buffer sorted = createBuffer(vectorSize);
+		cl::Event sortEvent;
+
+		cl::Kernel sortData = createKernel("selectionSort", input, sorted, (cl_int)dataSize);
+		executeKernel("selectionSort", sortData, globalSize, NULL, sortEvent);
+		kernelEvents.push_back(sortEvent);
+		return sorted;
+	}
+
+	// Outputs bitonicMergeSort's mergePath work-items each write, matching MERGE_ITEMS in the kernels
+	static const size_t mergeItems = 8;
+
+	// Sorts the data into ascending order with a comparison sort. bitonicSortLocal sorts every tile of local size values
+	// in local memory, then each mergePath launch merges pairs of sorted runs into runs twice as wide. The local size
+	// must be a power of two of at least mergeItems. Returns a buffer holding the sorted data.
+	cl::Buffer bitonicMergeSort(cl::Buffer input, size_t dataSize, size_t localSize, vector<cl::Event>& kernelEvents)
+	{
+		size_t groups = max((dataSize + localSize - 1) / localSize, (size_t)1);
+		cl::Buffer sorted[2] = {
+			cl::Buffer(context, CL_MEM_READ_WRITE, max(dataSize, (size_t)1) * sizeof(Element)),
+			cl::Buffer(context, CL_MEM_READ_WRITE, max(dataSize, (size_t)1) * sizeof(Element))
+		};
+		cl::Event tileEvent;
+
+		cl::Kernel tiles = createKernel("bitonicSortLocal", input, sorted[0], cl::Local(localSize * sizeof(Element)), (cl_int)dataSize);
+		executeKernel("bitonicSortLocal", tiles, groups * localSize, localSize, tileEvent);
+		kernelEvents.push_back(tileEvent);
+
+		// Each launch reads the previous launch's output
+		size_t mergeGroups = max((dataSize + mergeItems * localSize - 1) / (mergeItems * localSize), (size_t)1);
+		int current = 0;
+		for (size_t width = localSize; width < dataSize; width *= 2)
+		{
+			cl::Event mergeEvent;
+			cl::Kernel merge = createKernel("mergePath", sorted[current], sorted[1 - current], (cl_int)width, (cl_int)dataSize);
+			executeKernel("mergePath", merge, mergeGroups * localSize, localSize, mergeEvent);
+			kernelEvents.push_back(mergeEvent);
+			current = 1 - current;
+		}
+		return sorted[current];
+	}
+
+	// Sorts the host can choose between, see preferredSort
+	enum SortAlgorithm { RadixSort, BitonicMergeSort, SelectionSort };
+
+	// Picks the sort for the selected device: the bitonic and merge sort on CPUs, whose scattered writes make the radix
+	// sort slow, otherwise the radix sort for the element types it supports. selectionSort is the fallback when the local
+	// size rules out both.
+	SortAlgorithm preferredSort(size_t localSize)
+	{
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		bool bitonic = localSize >= mergeItems && (localSize & (localSize - 1)) == 0;
+		bool radix = radixSortable() && localSize >= (1 << radixBits);
+		if (bitonic && (device.getInfo<CL_DEVICE_TYPE>() == CL_DEVICE_TYPE_CPU || !radix))
+			return BitonicMergeSort;
+		return radix ? RadixSort : SelectionSort;
+	}
+
+	// Sorts the data into ascending order with the given sort. Returns a buffer holding the sorted data.
+	cl::Buffer sort(SortAlgorithm algorithm, cl::Buffer input, size_t dataSize, size_t localSize, vector<cl::Event>& kernelEvents)
+	{
+		switch (algorithm)
+		{
+		case RadixSort:
+			return radixSort(input, dataSize, localSize, kernelEvents);
+		case BitonicMergeSort:
+			return bitonicMergeSort(input, dataSize, localSize, kernelEvents);
+		default:
+			return selectionSort(input, dataSize, localSize, kernelEvents);
+		}
+	}
+
+	// Names of the kernels a sort launches, in the order it adds their events
+	static vector<string> sortKernelNames(SortAlgorithm algorithm, size_t dataSize, size_t localSize)
+	{
+		vector<string> names;
+		if (algorithm == RadixSort)
+		{
+			for (int shift = 0; shift < 32; shift += radixBits)
+			{
+				string bits = " (bits " + to_string(shift) + "-" + to_string(shift + radixBits - 1) + ")";
+				names.push_back("radixCount" + bits);
+				names.push_back("radixScan" + bits);
+				names.push_back("radixScatter" + bits);
+			}
+		}
+		else if (algorithm == BitonicMergeSort)
+		{
+			names.push_back("bitonicSortLocal");
+			for (size_t width = localSize; width < dataSize; width *= 2)
+				names.push_back("mergePath (runs of " + to_string(width) + ")");
+		}
+		else
+			names.push_back("selectionSort");
+		return names;
+	}
+
+	// Most distinct ranks percentiles reads with radixSelect before one sort becomes the cheaper way to get them
+	static const size_t selectRankLimit = 2;
+
+	// Values at the given percentiles (0 to 100) of the data, all read from one histogram when the range between
+	// minValue and maxValue fits, otherwise with radixSelect when only a few ranks are needed, otherwise from one sort.
+	// Adds the name of every kernel it launches alongside its event.
+	vector<double> percentiles(cl::Buffer input, size_t dataSize, Element minValue, Element maxValue, const vector<double>& requested, Interpolation rule,
+		size_t localSize, vector<string>& kernelNames, vector<cl::Event>& kernelEvents)
+	{
+		vector<size_t> ranks = Percentiles::ranks(requested, rule, dataSize);
+		if (ranks.empty())
+			return Percentiles::resolve(requested, rule, dataSize, [](size_t) { return 0.0; });
+
+		if (histogramFits(minValue, maxValue))
+		{
+			kernelNames.push_back(histogramKernelName((size_t)maxValue - minValue + 1));
+			Histogram counts = histogram(input, dataSize, (cl_int)minValue, (cl_int)maxValue, localSize, kernelEvents);
+			return Percentiles::resolve(requested, rule, dataSize, [&](size_t rank) { return (double)counts.valueAt(rank); });
+		}
+
+		if (radixSortable() && ranks.size() <= selectRankLimit)
+		{
+			map<size_t, Element> values;
+			for (size_t rank : ranks)
+			{
+				for (int shift = 32 - selectBits; shift >= 0; shift -= selectBits)
+					kernelNames.push_back("radixSelectCount (rank " + to_string(rank) + ", bits " + to_string(shift) + "-" + to_string(shift + selectBits - 1) + ")");
+				values[rank] = radixSelect(input, dataSize, rank, localSize, kernelEvents);
+			}
+			return Percentiles::resolve(requested, rule, dataSize, [&](size_t rank) { return (double)values[rank]; });
+		}
+
+		SortAlgorithm algorithm = preferredSort(localSize);
+		vector<string> sortNames = sortKernelNames(algorithm, dataSize, localSize);
+		kernelNames.insert(kernelNames.end(), sortNames.begin(), sortNames.end());
+		vector<Element> sorted = readKernelBuffer(sort(algorithm, input, dataSize, localSize, kernelEvents), dataSize * sizeof(Element), vector<Element>(dataSize));
+		return Percentiles::resolve(requested, rule, dataSize, [&](size_t rank) { return (double)sorted[rank]; });
+	}
+
+	// Waits for every queued command to finish
+	void finish()
+	{
+		queue.finish();
 	}
 
 	// Reads a kernel buffer and returns the vector output
-	vector<mytype> readKernelBuffer(cl::Buffer readBuffer, size_t size, vector<mytype> readVector)
+	template <typename T>
+	vector<T> readKernelBuffer(cl::Buffer readBuffer, size_t size, vector<T> readVector)
 	{
 		// Copy the result from device to host
 		queue.enqueueReadBuffer(readBuffer, CL_TRUE, 0, size, &readVector[0]);
 		queue.finish(); // Wait to finish
 		return readVector;
 	}
+
+private:
+	// Runs varianceWelford and momentsMerge with moments of the precision the program was built with
+	template <typename T>
+	Moments<double> reduceMoments(cl::Buffer input, size_t dataSize, size_t localSize, size_t groups, vector<cl::Event>& kernelEvents)
+	{
+		cl::Buffer partials(context, CL_MEM_READ_WRITE, groups * sizeof(Moments<T>));
+		cl::Buffer result(context, CL_MEM_READ_WRITE, sizeof(Moments<T>));
+		cl::Event reduceEvent, mergeEvent;
+
+		cl::Kernel reduce = createKernel("varianceWelford", input, partials, cl::Local(localSize * sizeof(Moments<T>)), (cl_int)dataSize);
+		executeKernel("varianceWelford", reduce, groups * localSize, localSize, reduceEvent);
+
+		cl::Kernel merge = createKernel("momentsMerge", partials, result, cl::Local(localSize * sizeof(Moments<T>)), (cl_int)groups);
+		executeKernel("momentsMerge", merge, localSize, localSize, mergeEvent);
+
+		kernelEvents.push_back(reduceEvent);
+		kernelEvents.push_back(mergeEvent);
+		Moments<T> moments = readKernelBuffer(result, sizeof(Moments<T>), vector<Moments<T>>(1))[0];
+		return { moments.count, 0, (double)moments.mean, (double)moments.m2 };
+	}
 };
\ No newline at end of file
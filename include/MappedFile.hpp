@@ -0,0 +1,129 @@
+#pragma once
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+// Read-only view of a whole file mapped into memory, released when the instance goes out of scope
+class MappedFile
+{
+	const char* bytes = nullptr;
+	size_t length = 0;
+
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mapHandle = NULL;
+#else
+	int fileDescriptor = -1;
+#endif
+
+public:
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	// Maps the given file into memory and hints that it will be read sequentially, returns false if it can't be opened
+	bool open(const string& file_url)
+	{
+		close();
+
+#ifdef _WIN32
+		fileHandle = CreateFileA(file_url.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(fileHandle, &fileSize)) {
+			close();
+			return false;
+		}
+		length = (size_t)fileSize.QuadPart;
+
+		// Empty files can't be mapped, but are still valid
+		if (length == 0)
+			return true;
+
+		mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapHandle == NULL) {
+			close();
+			return false;
+		}
+
+		bytes = (const char*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+		if (bytes == nullptr) {
+			close();
+			return false;
+		}
+#else
+		fileDescriptor = ::open(file_url.c_str(), O_RDONLY);
+		if (fileDescriptor < 0)
+			return false;
+
+		struct stat fileInfo;
+		if (fstat(fileDescriptor, &fileInfo) != 0) {
+			close();
+			return false;
+		}
+		length = (size_t)fileInfo.st_size;
+
+		// Empty files can't be mapped, but are still valid
+		if (length == 0)
+			return true;
+
+		void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (view == MAP_FAILED) {
+			close();
+			return false;
+		}
+		madvise(view, length, MADV_SEQUENTIAL);
+		bytes = (const char*)view;
+#endif
+		return true;
+	}
+
+	// Unmaps the file and releases its handles
+	void close()
+	{
+#ifdef _WIN32
+		if (bytes != nullptr)
+			UnmapViewOfFile(bytes);
+		if (mapHandle != NULL)
+			CloseHandle(mapHandle);
+		if (fileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(fileHandle);
+		mapHandle = NULL;
+		fileHandle = INVALID_HANDLE_VALUE;
+#else
+		if (bytes != nullptr)
+			munmap((void*)bytes, length);
+		if (fileDescriptor >= 0)
+			::close(fileDescriptor);
+		fileDescriptor = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+	const char* begin() const { return bytes; }
+	const char* end() const { return bytes + length; }
+	size_t size() const { return length; }
+};
\ No newline at end of file
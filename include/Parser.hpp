@@ -1,63 +1,352 @@
 # pragma once
+# include <atomic>
+# include <chrono>
+# include <condition_variable>
+# include <cstring>
+# include <functional>
+# include <mutex>
+# include <thread>
+# include "BlockArchive.hpp"
 # include "Helper.hpp"
+# include "MappedFile.hpp"
+# include "RecordCache.hpp"
+# include "Records.hpp"
+# include "Scanner.hpp"
 
 class Parser
 {
+public:
+	// Called with the records read so far, the first row and number of rows just added, and the most rows the file can hold.
+	// Rows passed to the handler stay at the same address until the returned records are modified. It is called at least
+	// once, with no rows when the file holds none.
+	typedef function<void(const Records& records, size_t firstRow, size_t rowCount, size_t expectedRows)> ChunkHandler;
+
+	// Converts a decimal number straight into an integer multiplied by 100, rounding any further digits half away from zero
+	static int parseFixedPoint(const char* first, const char* last)
+	{
+		bool negative = false;
+		if (first < last && (*first == '-' || *first == '+'))
+			negative = (*first++ == '-');
+
+		// Whole part
+		int value = 0;
+		while (first < last && (unsigned)(*first - '0') < 10)
+			value = value * 10 + (*first++ - '0');
+		value *= 100;
+
+		// First two decimal places are kept exactly, the third decides the rounding
+		if (first < last && *first == '.')
+		{
+			first++;
+			int scale = 10;
+			while (scale > 0 && first < last && (unsigned)(*first - '0') < 10)
+			{
+				value += (*first++ - '0') * scale;
+				scale /= 10;
+			}
+			if (first < last && (unsigned)(*first - '5') < 5)
+				value++;
+		}
+		return negative ? -value : value;
+	}
+
+private:
 	Helper* helper;
-	ifstream file;
-	string line;
 
-public:
-	// Reads the data from a given text file url and returns its last column as a vector of integers (values are multipled by 100)
-	vector<int> readFile(string& file_url)
+	// Smallest block of bytes worth handing to a separate thread
+	static const size_t minChunkBytes = 1 << 20;
+
+	// Largest block of bytes parsed before it is handed on, so uploads can start while the rest of the file is parsed
+	static const size_t pipelineChunkBytes = 1 << 22;
+
+	// Bytes given to the scanner at a time, small enough for its offsets to stay in cache
+	static const size_t scanBlockBytes = 1 << 18;
+
+	// Counts the records in a block of bytes, including a final line without a trailing newline
+	size_t countLines(const char* first, const char* last)
+	{
+		size_t lines = 0;
+		const char* pos = first;
+		while (pos < last)
+		{
+			const char* lineEnd = (const char*)memchr(pos, '\n', last - pos);
+			if (lineEnd == nullptr)
+				return lines + 1;
+			lines++;
+			pos = lineEnd + 1;
+		}
+		return lines;
+	}
+
+	// Reads the next space separated whole number in a line, moving the position past it
+	static int parseInteger(const char*& pos, const char* lineEnd)
+	{
+		while (pos < lineEnd && *pos == ' ')
+			pos++;
+
+		int value = 0;
+		while (pos < lineEnd && (unsigned)(*pos - '0') < 10)
+			value = value * 10 + (*pos++ - '0');
+
+		while (pos < lineEnd && *pos != ' ')
+			pos++;
+		return value;
+	}
+
+	// Splits a line into its columns and appends them as a new row
+	void parseRecord(const char* lineStart, const char* fieldStart, const char* lineEnd, Records& records)
 	{
-		cout << "\nReading in data from file... " << endl;
-		cout << "  Note: this may take a few moments... ";
-		vector<int> data;
+		const char* pos = lineStart;
+		while (pos < fieldStart && *pos != ' ')
+			pos++;
+		records.station.push_back(records.stationId(lineStart, pos - lineStart));
+
+		int year = parseInteger(pos, fieldStart);
+		int month = parseInteger(pos, fieldStart);
+		int day = parseInteger(pos, fieldStart);
+		int time = parseInteger(pos, fieldStart);
+
+		records.year.push_back((cl_short)year);
+		records.month.push_back((cl_uchar)month);
+		records.day.push_back((cl_uchar)day);
+		records.time.push_back((cl_short)time);
+		records.timestamp.push_back(Records::packTimestamp(year, month, day, time));
+		records.temperature.push_back(parseFixedPoint(fieldStart, lineEnd));
+	}
 
-		file.open(file_url);
-		if (file.is_open())
+	// Parses every line in a block of bytes, appending each one to the given records.
+	// The expected row count only sizes the columns up front, the scanner finds the lines itself.
+	void parseChunk(const char* first, const char* last, size_t expectedRows, Records& records)
+	{
+		records.reserve(expectedRows);
+		Scanner scanner;
+
+		const char* block = first;
+		while (block < last)
 		{
-			// Get data from file
-			while (getline(file, line))
+			size_t blockLength = min((size_t)(last - block), scanBlockBytes);
+			size_t consumed = scanner.scan(block, blockLength, block + blockLength == last);
+
+			// A line longer than the block, scan the rest of the chunk in one go
+			if (consumed == 0)
+				consumed = scanner.scan(block, last - block, true);
+
+			const char* lineStart = block;
+			for (size_t i = 0; i < scanner.lineEnds.size(); i++)
 			{
-				// Get last value in line and multiply by 100
-				int lastVal = stof(line.substr(line.rfind(" "))) * 100;
-				data.push_back(lastVal); // add to vector
+				const char* fieldStart = block + scanner.fieldStarts[i];
+				const char* lineEnd = block + scanner.lineEnds[i];
+				const char* nextLine = lineEnd + 1;
+
+				// Ignore carriage returns and blank lines
+				if (lineEnd > fieldStart && lineEnd[-1] == '\r')
+					lineEnd--;
+				if (lineEnd > fieldStart)
+					parseRecord(lineStart, fieldStart, lineEnd, records);
+
+				lineStart = nextLine;
 			}
-			file.close();
-			cout << "Complete." << endl;
-			cout << "  Total records in file: " << data.size() << endl;
-			return data;
+			block += consumed;
 		}
-		else {
-			cerr << "\nUnable to open file! Check that the file exists and is inside the 'datasets' folder.\n";
-			exit(0);
+	}
+
+	// Splits a block of bytes into a number of ranges, moving each split point to the start of the next line
+	vector<const char*> splitChunks(const char* first, const char* last, size_t chunkCount)
+	{
+		vector<const char*> bounds = { first };
+		size_t chunkBytes = (last - first) / chunkCount;
+
+		for (size_t i = 1; i < chunkCount; i++)
+		{
+			const char* split = max(first + i * chunkBytes, bounds.back());
+			const char* lineEnd = (const char*)memchr(split, '\n', last - split);
+			bounds.push_back((lineEnd == nullptr) ? last : lineEnd + 1);
 		}
+		bounds.push_back(last);
+		return bounds;
 	}
 
-	// Adds a given padded value to a given data vector, if local size isn't a factor of the data size
-	vector<int> padData(vector<int> data, size_t localSize, size_t paddingSize, int value = 0)
+	// Parses a number of chunks on multiple threads, returning the number of threads used. Chunks are appended to the
+	// records in order as soon as they are ready and passed to the handler, so they can be used while later chunks are
+	// still being parsed. The expected rows must be at least the number of records the chunks hold.
+	size_t parseChunks(size_t chunkCount, size_t expectedRows, const function<void(size_t, Records&)>& parseOne, Records& records, const ChunkHandler& onChunk)
 	{
-		if (paddingSize)
+		size_t workerCount = min((size_t)threadCount, chunkCount);
+
+		// Reserving for every expected row keeps the columns in place while chunks are in use
+		records.reserve(expectedRows);
+
+		vector<Records> chunks(chunkCount);
+		vector<char> parsed(chunkCount, false);
+		atomic<size_t> nextChunk(0);
+		mutex parsedMutex;
+		condition_variable parsedSignal;
+
+		// Claims and parses the next unparsed chunk, returns false once every chunk has been claimed
+		auto parseNext = [&]() {
+			size_t i = nextChunk++;
+			if (i >= chunkCount)
+				return false;
+
+			parseOne(i, chunks[i]);
+			{
+				lock_guard<mutex> lock(parsedMutex);
+				parsed[i] = true;
+			}
+			parsedSignal.notify_all();
+			return true;
+		};
+
+		vector<thread> workers;
+		for (size_t i = 1; i < workerCount; i++)
+			workers.emplace_back([&]() { while (parseNext()); });
+
+		// Hand the chunks on in order, the calling thread helps with parsing while the next one isn't ready
+		for (size_t i = 0; i < chunkCount; i++)
 		{
-			vector<int> extendVec(localSize - paddingSize, value);
-			data.insert(data.end(), extendVec.begin(), extendVec.end());
+			unique_lock<mutex> lock(parsedMutex);
+			while (!parsed[i])
+			{
+				lock.unlock();
+				bool claimed = parseNext();
+				lock.lock();
+				if (!claimed)
+					parsedSignal.wait(lock, [&]() { return parsed[i] != 0; });
+			}
+			lock.unlock();
+
+			// Growing past the reserved rows would move columns the handler may still be reading
+			if (records.size() + chunks[i].size() > expectedRows)
+			{
+				cerr << "\nUnable to read file! It holds more records than expected.\n";
+				exit(0);
+			}
+
+			size_t firstRow = records.size();
+			records.append(chunks[i]);
+			chunks[i] = Records();
+			if (onChunk)
+				onChunk(records, firstRow, records.size() - firstRow, expectedRows);
 		}
-		return data;
+
+		for (thread& worker : workers)
+			worker.join();
+
+		// Let the handler see an empty file
+		if (chunkCount == 0 && onChunk)
+			onChunk(records, 0, 0, expectedRows);
+		return workerCount;
+	}
+
+	// Parses every line of a mapped text file, split at line boundaries into at least one chunk per thread
+	size_t parseText(const MappedFile& mapped, Records& records, const ChunkHandler& onChunk)
+	{
+		// Small files stay on one thread
+		size_t chunkCount = max(max(min((size_t)threadCount, mapped.size() / minChunkBytes), mapped.size() / pipelineChunkBytes), (size_t)1);
+		vector<const char*> bounds = splitChunks(mapped.begin(), mapped.end(), chunkCount);
+
+		// Lines are counted once for the whole file, each chunk expects a share of them in proportion to its bytes
+		size_t lines = countLines(mapped.begin(), mapped.end());
+		return parseChunks(chunkCount, lines, [&](size_t i, Records& chunk) {
+			size_t chunkLines = mapped.size() ? (size_t)((double)lines * (bounds[i + 1] - bounds[i]) / mapped.size()) + 1 : 0;
+			parseChunk(bounds[i], bounds[i + 1], chunkLines, chunk);
+		}, records, onChunk);
 	}
 
-	// Removes padded values from the given vector starting at a given location
-	vector<int> removePad(vector<int> data, size_t startPoint)
+	// Parses every frame of a compressed archive, each thread decompresses a frame in memory and parses it straight away
+	size_t parseArchive(const BlockArchive& archive, Records& records, const ChunkHandler& onChunk)
 	{
-		data.erase(data.begin() + startPoint, data.end());
-		return data;
+		atomic<bool> corrupt(false);
+		size_t threadsUsed = parseChunks(archive.frameCount(), archive.lineCount(), [&](size_t i, Records& chunk) {
+			vector<char> frame;
+			if (archive.decompressFrame(i, frame))
+				parseChunk(frame.data(), frame.data() + frame.size(), archive.frameLineCount(i), chunk);
+			else
+				corrupt = true;
+
+			// A frame can't hold more records than the lines its index entry counts
+			if (chunk.size() > archive.frameLineCount(i))
+			{
+				chunk = Records();
+				corrupt = true;
+			}
+		}, records, onChunk);
+
+		if (corrupt)
+		{
+			cerr << "\nUnable to decompress file! The compressed dataset is corrupt.\n";
+			exit(0);
+		}
+		return threadsUsed;
 	}
 
-	// Removes a given padded value from a given vector
-	vector<int> removePad(vector<int> data, int value)
+public:
+	// Number of threads used to parse a file, defaults to one per hardware thread
+	unsigned int threadCount = max(thread::hardware_concurrency(), 1u);
+
+	// Prints the file's details and parse time, turned off for repeated benchmark runs
+	bool showProgress = true;
+
+	// Loads and writes the binary cache, turned off to time the parse itself
+	bool useCache = true;
+
+	// Reads every column of a given text file url into a set of records (temperatures are multiplied by 100).
+	// If the text file is missing its compressed copy (file url + ".wxz") is read instead.
+	// A binary cache is written next to the file after the first parse and used until the file changes.
+	// The optional handler receives the rows in file order while the rest of the file is still being read.
+	Records readFile(string& file_url, const ChunkHandler& onChunk = nullptr)
 	{
-		data.erase(remove(data.begin(), data.end(), value), data.end());
-		return data;
+		if (showProgress)
+			cout << "\nReading in data from file... " << endl;
+		auto startTime = chrono::steady_clock::now();
+
+		// Use the compressed copy when there is no text file
+		string source_url = file_url;
+		MappedFile mapped;
+		BlockArchive archive;
+		bool compressed = !mapped.open(source_url);
+		if (compressed)
+		{
+			source_url = file_url + BlockArchive::extension();
+			if (!archive.open(source_url))
+			{
+				cerr << "\nUnable to open file! Check that the file exists and is inside the 'datasets' folder.\n";
+				exit(0);
+			}
+		}
+
+		Records records;
+		string cache_url = source_url + ".cache";
+		if (useCache && RecordCache::load(cache_url, source_url, records))
+		{
+			chrono::duration<double> loadTime = chrono::steady_clock::now() - startTime;
+			if (showProgress)
+			{
+				cout << "  Loaded from cache: " << cache_url << endl;
+				cout << "  Total records in file: " << records.size() << endl;
+				cout << "  Load time: " << fixed << setprecision(3) << loadTime.count() << " [secs]" << endl;
+			}
+			if (onChunk)
+				onChunk(records, 0, records.size(), records.size());
+			return records;
+		}
+
+		if (showProgress)
+			cout << "  Note: this may take a few moments... ";
+		size_t threadsUsed = compressed ? parseArchive(archive, records, onChunk) : parseText(mapped, records, onChunk);
+
+		chrono::duration<double> parseTime = chrono::steady_clock::now() - startTime;
+		if (showProgress)
+		{
+			cout << "Complete." << endl;
+			if (compressed)
+				cout << "  Decompressed: " << source_url << " (" << archive.compressedSize() << " -> " << archive.rawSize() << " bytes, " << archive.frameCount() << " frames)" << endl;
+			cout << "  Total records in file: " << records.size() << endl;
+			cout << "  Parse time: " << fixed << setprecision(3) << parseTime.count() << " [secs] (" << threadsUsed << " thread(s), " << Scanner::levelName(Scanner::detectLevel()) << " scanner)" << endl;
+		}
+
+		if (useCache && !RecordCache::save(cache_url, source_url, records))
+			cerr << "  Unable to write binary cache: " << cache_url << endl;
+		return records;
 	}
 };
\ No newline at end of file
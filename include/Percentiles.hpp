@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "Utils.h"
+
+// How a percentile that falls between two ranks of the sorted data is resolved
+enum class Interpolation
+{
+	Linear, // Weighted between the two values by the fractional rank
+	Lower, // The smaller value
+	Higher, // The larger value
+	Nearest, // The value at the nearest rank
+	Midpoint // The average of the two values
+};
+
+// Name of an interpolation rule, for output
+inline string interpolationName(Interpolation rule)
+{
+	switch (rule)
+	{
+	case Interpolation::Lower:
+		return "lower";
+	case Interpolation::Higher:
+		return "higher";
+	case Interpolation::Nearest:
+		return "nearest";
+	case Interpolation::Midpoint:
+		return "midpoint";
+	default:
+		return "linear";
+	}
+}
+
+// Resolves percentiles (0 to 100) to values from any source of the sorted data's values by rank
+struct Percentiles
+{
+	// Fractional rank of a percentile among count sorted values, from 0 to count - 1
+	static double position(double percentile, size_t count)
+	{
+		return min(max(percentile, 0.0), 100.0) / 100 * (count - 1);
+	}
+
+	// Ranks the given percentiles read, so they can all be fetched in one go
+	static vector<size_t> ranks(const vector<double>& percentiles, Interpolation rule, size_t count)
+	{
+		vector<size_t> needed;
+		if (count == 0)
+			return needed;
+		for (double percentile : percentiles)
+		{
+			double rank = position(percentile, count);
+			if (rule == Interpolation::Nearest)
+				needed.push_back((size_t)floor(rank + 0.5));
+			else
+			{
+				if (rule != Interpolation::Higher)
+					needed.push_back((size_t)floor(rank));
+				if (rule != Interpolation::Lower)
+					needed.push_back((size_t)ceil(rank));
+			}
+		}
+		sort(needed.begin(), needed.end());
+		needed.erase(unique(needed.begin(), needed.end()), needed.end());
+		return needed;
+	}
+
+	// Returns the value at each percentile given the value at any rank, or zeros when there is no data
+	static vector<double> resolve(const vector<double>& percentiles, Interpolation rule, size_t count, function<double(size_t)> valueAt)
+	{
+		vector<double> values(percentiles.size(), 0.0);
+		if (count == 0)
+			return values;
+		for (size_t i = 0; i < percentiles.size(); i++)
+		{
+			double rank = position(percentiles[i], count);
+			size_t lower = (size_t)floor(rank);
+			size_t higher = (size_t)ceil(rank);
+			switch (rule)
+			{
+			case Interpolation::Lower:
+				values[i] = valueAt(lower);
+				break;
+			case Interpolation::Higher:
+				values[i] = valueAt(higher);
+				break;
+			case Interpolation::Nearest:
+				values[i] = valueAt((size_t)floor(rank + 0.5));
+				break;
+			case Interpolation::Midpoint:
+				values[i] = (valueAt(lower) + valueAt(higher)) / 2;
+				break;
+			default:
+				values[i] = valueAt(lower) + (valueAt(higher) - valueAt(lower)) * (rank - lower);
+				break;
+			}
+		}
+		return values;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <map>
+#include "Utils.h"
+
+// Builds each combination of kernel source and build options once per context, so kernels specialised for
+// different element types can be created side by side without rebuilding the program
+class ProgramCache
+{
+	// Programs by context, source file and build options
+	static map<string, cl::Program>& programs()
+	{
+		static map<string, cl::Program> cache;
+		return cache;
+	}
+
+public:
+	// Returns the program for a source file built with the given options, building it on first use.
+	// Prints the build log and rethrows if the source fails to build.
+	static cl::Program get(const cl::Context& context, const string& source_url, const string& options)
+	{
+		ostringstream key;
+		key << (const void*)context() << '|' << source_url << '|' << options;
+
+		map<string, cl::Program>& cache = programs();
+		auto cached = cache.find(key.str());
+		if (cached != cache.end())
+			return cached->second;
+
+		cl::Program::Sources sources;
+		AddSources(sources, source_url);
+		cl::Program program(context, sources);
+
+		//build and debug the kernel code
+		try {
+			program.build(options.c_str());
+		}
+		catch (const cl::Error& err) {
+			cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << endl;
+			cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << endl;
+			cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << endl;
+			throw err;
+		}
+
+		cache[key.str()] = program;
+		return program;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,215 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "MappedFile.hpp"
+#include "Records.hpp"
+
+// Binary copy of a parsed dataset, stored column by column next to the text file so later runs can skip parsing.
+// Layout: header, one descriptor per column, the station dictionary, then each column's raw values starting on a 64 byte boundary.
+class RecordCache
+{
+	static const uint32_t version = 3;
+	static const size_t alignment = 64;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t columnCount;
+		uint64_t rowCount;
+		uint64_t sourceSize;
+		int64_t sourceModified;
+		uint64_t checksum; // over the station dictionary and every column block
+		uint64_t stationsOffset;
+		uint64_t stationsBytes; // null terminated names
+	};
+
+	struct Column
+	{
+		char name[16];
+		uint32_t elementSize;
+		uint32_t reserved;
+		uint64_t offset; // from the start of the file
+		uint64_t bytes;
+	};
+
+	static const char* magic() { return "WXCACHE"; }
+
+	static size_t alignUp(size_t offset)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	// FNV-1a over 8 byte words, the final partial word is zero padded
+	static uint64_t hash(const char* bytes, size_t length, uint64_t seed)
+	{
+		uint64_t value = seed;
+		size_t i = 0;
+		for (; i + 8 <= length; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			value = (value ^ word) * 1099511628211ull;
+		}
+		if (i < length)
+		{
+			uint64_t word = 0;
+			memcpy(&word, bytes + i, length - i);
+			value = (value ^ word) * 1099511628211ull;
+		}
+		return value;
+	}
+
+	// Size and last modified time of the source file, used to tell when the cache is stale
+	static bool sourceInfo(const string& file_url, uint64_t& size, int64_t& modified)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if (_stat64(file_url.c_str(), &info) != 0)
+			return false;
+#else
+		struct stat info;
+		if (stat(file_url.c_str(), &info) != 0)
+			return false;
+#endif
+		size = (uint64_t)info.st_size;
+		modified = (int64_t)info.st_mtime;
+		return true;
+	}
+
+public:
+	// Loads records from a cache file, returns false if it is missing, corrupt or older than the source file.
+	// The records are only replaced when the whole cache is valid.
+	static bool load(const string& cache_url, const string& file_url, Records& records)
+	{
+		Records loaded;
+		uint64_t sourceSize;
+		int64_t sourceModified;
+		if (!sourceInfo(file_url, sourceSize, sourceModified))
+			return false;
+
+		MappedFile mapped;
+		if (!mapped.open(cache_url) || mapped.size() < sizeof(Header))
+			return false;
+
+		Header header;
+		memcpy(&header, mapped.begin(), sizeof(Header));
+		if (memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != version)
+			return false;
+		if (header.sourceSize != sourceSize || header.sourceModified != sourceModified)
+			return false;
+
+		// Check the schema matches the columns this build expects
+		vector<string> names;
+		loaded.forEachColumn([&](const char* name, auto&) { names.push_back(name); });
+		if (header.columnCount != names.size() || mapped.size() < sizeof(Header) + names.size() * sizeof(Column))
+			return false;
+
+		vector<Column> columns(names.size());
+		memcpy(columns.data(), mapped.begin() + sizeof(Header), columns.size() * sizeof(Column));
+
+		// Station dictionary
+		if (header.stationsOffset + header.stationsBytes > mapped.size())
+			return false;
+		const char* namesStart = mapped.begin() + header.stationsOffset;
+		const char* namesEnd = namesStart + header.stationsBytes;
+		uint64_t checksum = hash(namesStart, (size_t)header.stationsBytes, 14695981039346656037ull);
+		for (const char* name = namesStart; name < namesEnd;)
+		{
+			const char* nameEnd = (const char*)memchr(name, '\0', namesEnd - name);
+			if (nameEnd == nullptr)
+				return false;
+			loaded.stations.emplace_back(name, nameEnd - name);
+			name = nameEnd + 1;
+		}
+
+		bool valid = true;
+		size_t index = 0;
+		loaded.forEachColumn([&](const char* name, auto& column) {
+			typedef typename remove_reference<decltype(column)>::type::value_type T;
+			const Column& info = columns[index++];
+			if (!valid || strncmp(info.name, name, sizeof(info.name)) != 0 || info.elementSize != sizeof(T)
+				|| info.bytes != header.rowCount * sizeof(T) || info.offset + info.bytes > mapped.size())
+			{
+				valid = false;
+				return;
+			}
+
+			const char* block = mapped.begin() + info.offset;
+			checksum = hash(block, (size_t)info.bytes, checksum);
+			column.resize((size_t)header.rowCount);
+			memcpy(column.data(), block, (size_t)info.bytes);
+		});
+
+		if (!valid || checksum != header.checksum)
+			return false;
+
+		records = move(loaded);
+		return true;
+	}
+
+	// Writes records to a cache file tagged with the source file's size and modified time, returns false on failure
+	static bool save(const string& cache_url, const string& file_url, Records& records)
+	{
+		Header header = {};
+		memcpy(header.magic, magic(), sizeof(header.magic));
+		header.version = version;
+		header.rowCount = records.size();
+		if (!sourceInfo(file_url, header.sourceSize, header.sourceModified))
+			return false;
+
+		// Lay out the station dictionary after the header and column descriptors, followed by the column blocks
+		vector<Column> columns;
+		size_t offset = sizeof(Header);
+		records.forEachColumn([&](const char*, auto&) { offset += sizeof(Column); });
+
+		string stationNames;
+		for (const string& name : records.stations)
+			stationNames.append(name.c_str(), name.size() + 1);
+		header.stationsOffset = offset;
+		header.stationsBytes = stationNames.size();
+		header.checksum = hash(stationNames.data(), stationNames.size(), 14695981039346656037ull);
+		offset += stationNames.size();
+
+		records.forEachColumn([&](const char* name, auto& column) {
+			typedef typename remove_reference<decltype(column)>::type::value_type T;
+			Column info = {};
+			memcpy(info.name, name, min(strlen(name), sizeof(info.name) - 1));
+			info.elementSize = sizeof(T);
+			info.offset = offset = alignUp(offset);
+			info.bytes = column.size() * sizeof(T);
+			columns.push_back(info);
+
+			header.checksum = hash((const char*)column.data(), (size_t)info.bytes, header.checksum);
+			offset += (size_t)info.bytes;
+		});
+		header.columnCount = (uint32_t)columns.size();
+
+		ofstream file(cache_url, ios::binary | ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write((const char*)&header, sizeof(Header));
+		file.write((const char*)columns.data(), columns.size() * sizeof(Column));
+		file.write(stationNames.data(), stationNames.size());
+
+		size_t index = 0;
+		records.forEachColumn([&](const char*, auto& column) {
+			const Column& info = columns[index++];
+			vector<char> padding((size_t)info.offset - (size_t)file.tellp(), 0);
+			file.write(padding.data(), padding.size());
+			file.write((const char*)column.data(), info.bytes);
+		});
+
+		file.close();
+		if (!file)
+		{
+			remove(cache_url.c_str());
+			return false;
+		}
+		return true;
+	}
+};
\ No newline at end of file
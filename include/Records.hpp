@@ -0,0 +1,140 @@
+#pragma once
+#include <cstring>
+#include "Utils.h"
+
+// Weather records stored column by column (structure of arrays), where row i of every column belongs to line i of the dataset
+struct Records
+{
+	// Id given to every station once the dictionary is full
+	static const cl_uchar unknownStation = 255;
+
+	// Type of the temperature column, the parser stores each value multiplied by 100
+	typedef cl_int Temperature;
+
+	// Station names in the order they were first seen, the station column stores an index into this list
+	vector<string> stations;
+
+	vector<cl_uchar> station;
+	vector<cl_short> year;
+	vector<cl_uchar> month;
+	vector<cl_uchar> day;
+	vector<cl_short> time; // HHMM
+	vector<cl_int> timestamp; // minutes since 1900-01-01 00:00, see packTimestamp
+	vector<Temperature> temperature; // multiplied by 100
+
+	// Calls the given visitor with the name and vector of every column, in storage order
+	template <typename Visitor>
+	void forEachColumn(Visitor visit)
+	{
+		visit("station", station);
+		visit("year", year);
+		visit("month", month);
+		visit("day", day);
+		visit("time", time);
+		visit("timestamp", timestamp);
+		visit("temperature", temperature);
+	}
+
+	// Packs a date and HHMM time into minutes since 1900-01-01 00:00, which sorts in time order and fits 32 bits until the year 5983.
+	// The same encoding is unpacked on the device by the ts_* helpers in my_kernels.cl.
+	static cl_int packTimestamp(int year, int month, int day, int hhmm)
+	{
+		// Days since 1970-01-01 (Hinnant's days_from_civil), moved to a 1900 epoch
+		year -= month <= 2;
+		int era = (year >= 0 ? year : year - 399) / 400;
+		int yearOfEra = year - era * 400;
+		int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+		int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+		int days = era * 146097 + dayOfEra - 719468 + 25567;
+
+		return days * 1440 + (hhmm / 100) * 60 + hhmm % 100;
+	}
+
+	// Unpacks a timestamp made by packTimestamp into its date and HHMM time
+	static void unpackTimestamp(cl_int timestamp, int& year, int& month, int& day, int& hhmm)
+	{
+		int minutes = timestamp % 1440;
+		hhmm = (minutes / 60) * 100 + minutes % 60;
+
+		// Hinnant's civil_from_days
+		int days = timestamp / 1440 - 25567 + 719468;
+		int era = (days >= 0 ? days : days - 146096) / 146097;
+		int dayOfEra = days - era * 146097;
+		int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+		int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+		int monthIndex = (5 * dayOfYear + 2) / 153;
+		day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+		month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+		year = yearOfEra + era * 400 + (month <= 2);
+	}
+
+	// Returns the id of a station name, adding it to the dictionary if it hasn't been seen before
+	cl_uchar stationId(const char* name, size_t length)
+	{
+		// Records are grouped by station, so the most recent station is checked first
+		if (!stations.empty() && stations[lastStation].size() == length && memcmp(stations[lastStation].data(), name, length) == 0)
+			return lastStation;
+
+		for (size_t i = 0; i < stations.size(); i++)
+		{
+			if (stations[i].size() == length && memcmp(stations[i].data(), name, length) == 0)
+				return lastStation = (cl_uchar)i;
+		}
+
+		if (stations.size() == unknownStation)
+			return unknownStation;
+		stations.emplace_back(name, length);
+		return lastStation = (cl_uchar)(stations.size() - 1);
+	}
+
+	// Returns the name of a station id
+	string stationName(cl_uchar id) const
+	{
+		return (id < stations.size()) ? stations[id] : "UNKNOWN";
+	}
+
+	size_t size() const
+	{
+		return temperature.size();
+	}
+
+	void reserve(size_t rows)
+	{
+		station.reserve(rows);
+		year.reserve(rows);
+		month.reserve(rows);
+		day.reserve(rows);
+		time.reserve(rows);
+		timestamp.reserve(rows);
+		temperature.reserve(rows);
+	}
+
+	// Appends every row of another set of records to the end of this one, translating its station ids into this dictionary
+	void append(const Records& other)
+	{
+		vector<cl_uchar> stationMap(256, unknownStation);
+		bool sameIds = true;
+		for (size_t i = 0; i < other.stations.size(); i++)
+		{
+			stationMap[i] = stationId(other.stations[i].data(), other.stations[i].size());
+			sameIds = sameIds && (stationMap[i] == i);
+		}
+
+		if (sameIds)
+			station.insert(station.end(), other.station.begin(), other.station.end());
+		else
+		{
+			for (cl_uchar id : other.station)
+				station.push_back(stationMap[id]);
+		}
+		year.insert(year.end(), other.year.begin(), other.year.end());
+		month.insert(month.end(), other.month.begin(), other.month.end());
+		day.insert(day.end(), other.day.begin(), other.day.end());
+		time.insert(time.end(), other.time.begin(), other.time.end());
+		timestamp.insert(timestamp.end(), other.timestamp.begin(), other.timestamp.end());
+		temperature.insert(temperature.end(), other.temperature.begin(), other.temperature.end());
+	}
+
+private:
+	cl_uchar lastStation = 0;
+};
\ No newline at end of file
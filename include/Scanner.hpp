@@ -0,0 +1,222 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCANNER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts AVX2 intrinsics anywhere, GCC and Clang need the function to be compiled for the target
+#if defined(SCANNER_X86) && !defined(_MSC_VER)
+#define SCANNER_AVX2 __attribute__((target("avx2")))
+#else
+#define SCANNER_AVX2
+#endif
+
+using namespace std;
+
+// Finds the end of every line and the start of its last space separated field in a block of bytes,
+// comparing 64 bytes at a time with AVX2 or SSE2 when the CPU supports it
+class Scanner
+{
+public:
+	enum Level { SCALAR, SSE2, AVX2 };
+
+	// Offsets relative to the start of the scanned block, one entry per line
+	vector<uint32_t> fieldStarts;
+	vector<uint32_t> lineEnds;
+
+	// Returns the best instruction set available on this CPU, detected once
+	static Level detectLevel()
+	{
+		static const Level level = queryLevel();
+		return level;
+	}
+
+	static const char* levelName(Level level)
+	{
+		switch (level)
+		{
+		case AVX2: return "AVX2";
+		case SSE2: return "SSE2";
+		default: return "scalar";
+		}
+	}
+
+	// Scans a block which must start at the beginning of a line. Lines are recorded up to the last newline,
+	// or to the end of the block when it is the final one. Returns the number of bytes consumed.
+	size_t scan(const char* block, size_t length, bool finalBlock, Level level = detectLevel())
+	{
+		fieldStarts.clear();
+		lineEnds.clear();
+		lineStart = 0;
+		lastSpace = -1;
+
+		size_t pos = 0;
+		switch (level)
+		{
+#ifdef SCANNER_X86
+		case AVX2: pos = scanAvx2(block, length); break;
+		case SSE2: pos = scanSse2(block, length); break;
+#endif
+		default: break;
+		}
+
+		// Remaining bytes that don't fill a whole window
+		for (; pos < length; pos += 64)
+		{
+			size_t windowLength = (length - pos < 64) ? length - pos : 64;
+			uint64_t newlines = 0, spaces = 0;
+			for (size_t i = 0; i < windowLength; i++)
+			{
+				newlines |= (uint64_t)(block[pos + i] == '\n') << i;
+				spaces |= (uint64_t)(block[pos + i] == ' ') << i;
+			}
+			addLines(newlines, spaces, pos);
+		}
+
+		// A final line without a trailing newline
+		if (finalBlock && lineStart < length)
+			addLine(length);
+
+		return finalBlock ? length : lineStart;
+	}
+
+private:
+	size_t lineStart = 0;
+	int64_t lastSpace = -1;
+
+	static Level queryLevel()
+	{
+#if defined(SCANNER_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		// AVX2 needs the CPU flag and the OS saving the YMM registers
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+		if (maxLeaf >= 7 && osSavesYmm)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+				return AVX2;
+		}
+		return SSE2;
+#elif defined(SCANNER_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return SSE2;
+		return SCALAR;
+#else
+		return SCALAR;
+#endif
+	}
+
+	static int lowestBit(uint64_t mask)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return (int)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, (unsigned long)mask))
+			return (int)index;
+		_BitScanForward(&index, (unsigned long)(mask >> 32));
+		return (int)index + 32;
+#else
+		return __builtin_ctzll(mask);
+#endif
+	}
+
+	static int highestBit(uint64_t mask)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanReverse64(&index, mask);
+		return (int)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanReverse(&index, (unsigned long)(mask >> 32)))
+			return (int)index + 32;
+		_BitScanReverse(&index, (unsigned long)mask);
+		return (int)index;
+#else
+		return 63 - __builtin_clzll(mask);
+#endif
+	}
+
+	void addLine(size_t lineEnd)
+	{
+		size_t fieldStart = (lastSpace >= (int64_t)lineStart) ? (size_t)lastSpace + 1 : lineStart;
+		fieldStarts.push_back((uint32_t)fieldStart);
+		lineEnds.push_back((uint32_t)lineEnd);
+		lineStart = lineEnd + 1;
+	}
+
+	// Records every line ending in a 64 byte window, given bit masks of its newlines and spaces
+	void addLines(uint64_t newlines, uint64_t spaces, size_t windowStart)
+	{
+		while (newlines)
+		{
+			int bit = lowestBit(newlines);
+			uint64_t before = spaces & ((1ull << bit) - 1);
+			if (before)
+				lastSpace = windowStart + highestBit(before);
+			addLine(windowStart + bit);
+
+			spaces &= ~before;
+			newlines &= newlines - 1;
+		}
+		if (spaces)
+			lastSpace = windowStart + highestBit(spaces);
+	}
+
+#ifdef SCANNER_X86
+	size_t scanSse2(const char* block, size_t length)
+	{
+		const __m128i newline = _mm_set1_epi8('\n');
+		const __m128i space = _mm_set1_epi8(' ');
+
+		size_t pos = 0;
+		for (; pos + 64 <= length; pos += 64)
+		{
+			uint64_t newlines = 0, spaces = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				__m128i bytes = _mm_loadu_si128((const __m128i*)(block + pos + i * 16));
+				newlines |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)) << (i * 16);
+				spaces |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)) << (i * 16);
+			}
+			addLines(newlines, spaces, pos);
+		}
+		return pos;
+	}
+
+	SCANNER_AVX2 size_t scanAvx2(const char* block, size_t length)
+	{
+		const __m256i newline = _mm256_set1_epi8('\n');
+		const __m256i space = _mm256_set1_epi8(' ');
+
+		size_t pos = 0;
+		for (; pos + 64 <= length; pos += 64)
+		{
+			__m256i low = _mm256_loadu_si256((const __m256i*)(block + pos));
+			__m256i high = _mm256_loadu_si256((const __m256i*)(block + pos + 32));
+			uint64_t newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline))
+				| ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline)) << 32);
+			uint64_t spaces = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, space))
+				| ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, space)) << 32);
+			addLines(newlines, spaces, pos);
+		}
+		return pos;
+	}
+#endif
+};
\ No newline at end of file
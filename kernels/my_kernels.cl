@@ -1,12 +1,75 @@
-kernel void minReduce(global const int* input, global int* results, local int *scratch)
+// Double precision is used wherever the device supports it, the host builds with -D USE_FP64 when it has cl_khr_fp64
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+// Element (T) and accumulator (ACC) types of the statistics, two-stage, Welford and sort kernels, set by the host
+// build options (e.g. -D T=float -D T_MIN=-INFINITY -D T_MAX=INFINITY -D ACC=double). The atomic *Reduce kernels stay on int.
+#ifndef T
+#define T int
+#define T_MIN INT_MIN
+#define T_MAX INT_MAX
+#endif
+#ifndef ACC
+#define ACC long
+#endif
+
+// Packed timestamps are minutes since 1900-01-01 00:00 (see Records::packTimestamp), so time ranges
+// are integer comparisons and the helpers below recover the calendar fields when grouping is needed
+int ts_minute(int ts)
+{
+  return ts % 60;
+}
+
+int ts_hour(int ts)
+{
+  return (ts / 60) % 24;
+}
+
+// Whole days since 1900-01-01, useful for daily buckets
+int ts_days(int ts)
+{
+  return ts / 1440;
+}
+
+// Converts a timestamp into (year, month, day) using Hinnant's civil_from_days
+int3 ts_date(int ts)
+{
+  int days = ts / 1440 - 25567 + 719468;
+  int era = (days >= 0 ? days : days - 146096) / 146097;
+  int dayOfEra = days - era * 146097;
+  int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  int monthIndex = (5 * dayOfYear + 2) / 153;
+  int day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  int month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  return (int3)(yearOfEra + era * 400 + (month <= 2), month, day);
+}
+
+int ts_year(int ts)
+{
+  return ts_date(ts).x;
+}
+
+int ts_month(int ts)
+{
+  return ts_date(ts).y;
+}
+
+int ts_day(int ts)
+{
+  return ts_date(ts).z;
+}
+
+kernel void minReduce(global const int* input, global int* results, local int *scratch, int dataSize)
 {
   // Initalize variables
   int gid = get_global_id(0);
   int lid = get_local_id(0);
   int N = get_local_size(0);
 
-  // Cache all values from global to local memory
-  scratch[lid] = input[gid];
+  // Cache all values from global to local memory, work-items past the end of the data hold the identity
+  scratch[lid] = (gid < dataSize) ? input[gid] : INT_MAX;
 
   // Wait for local memory to be copied
   barrier(CLK_LOCAL_MEM_FENCE);
@@ -33,15 +96,15 @@ kernel void minReduce(global const int* input, global int* results, local int *s
   }
 }
 
-kernel void maxReduce(global const int* input, global int* results, local int *scratch)
+kernel void maxReduce(global const int* input, global int* results, local int *scratch, int dataSize)
 {
   // Initalize variables
   int gid = get_global_id(0);
   int lid = get_local_id(0);
   int N = get_local_size(0);
 
-  // Cache all values from global to local memory
-  scratch[lid] = input[gid];
+  // Cache all values from global to local memory, work-items past the end of the data hold the identity
+  scratch[lid] = (gid < dataSize) ? input[gid] : INT_MIN;
 
   // Wait for local memory to be copied
   barrier(CLK_LOCAL_MEM_FENCE);
@@ -68,14 +131,24 @@ kernel void maxReduce(global const int* input, global int* results, local int *s
   }
 }
 
-kernel void sumReduce(global int const* input, global int* results, local int *scratch) {
+// Sums and variances accumulate in 64 bits. When the host builds with -D USE_INT64_ATOMICS (the device has
+// cl_khr_int64_base_atomics) each work-group adds its sum to results[0], otherwise it writes its sum to results[group]
+// and the host reduces the partials with sumMerge.
+#ifdef USE_INT64_ATOMICS
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#define ADD_LONG_RESULT(results, value) atom_add(results, value)
+#else
+#define ADD_LONG_RESULT(results, value) (results[get_group_id(0)] = (value))
+#endif
+
+kernel void sumReduce(global int const* input, global long* results, local long *scratch, int dataSize) {
 	// Initalize variables
   int gid = get_global_id(0);
   int lid = get_local_id(0);
   int N = get_local_size(0);
 
-  // Cache all values from global to local memory
-  scratch[lid] = input[gid];
+  // Cache all values from global to local memory, work-items past the end of the data hold the identity
+  scratch[lid] = (gid < dataSize) ? input[gid] : 0;
 
   // Wait for local memory to be copied
   barrier(CLK_LOCAL_MEM_FENCE);
@@ -95,64 +168,1050 @@ kernel void sumReduce(global int const* input, global int* results, local int *s
   // Set result for the statistic
   if (lid == 0)
   {
-    atomic_add(results, scratch[lid]);
+    ADD_LONG_RESULT(results, scratch[lid]);
   }
 }
 
-kernel void varianceReduce(global int const* input, global int* results, local int *scratch, int mean, int dataSize) {
+// Sums the squared differences from the mean, both multiplied by 100, so the result is multiplied by 10,000
+kernel void varianceReduce(global int const* input, global long* results, local long *scratch, int mean, int dataSize) {
 	// Initalize variables
   int gid = get_global_id(0);
   int lid = get_local_id(0);
   int N = get_local_size(0);
 
-  // Ignore padded values
-  if (gid < dataSize)
+  // Cache all values from global to local memory and perform variance calculation, work-items past the end of the data count as zero
+  long deviation = (gid < dataSize) ? input[gid] - mean : 0;
+  scratch[lid] = deviation * deviation;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate sum
+  for (int i = 1; i < N; i *= 2)
+  {
+    if ((lid % (i * 2) == 0) && ((lid + i) < N))
+    {
+      scratch[lid] += scratch[lid + i];
+    }
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Set result for the statistic
+  if (lid == 0)
+  {
+    ADD_LONG_RESULT(results, scratch[lid]);
+  }
+}
+
+// Sequential addressing versions of the reductions above. Each step halves the number of active work-items, which
+// stay packed at the start of the work-group so whole SIMD groups go idle instead of every other lane diverging.
+// The last steps, once 32 or fewer work-items are active, are unrolled. On a device known to execute at least 32
+// work-items in lock-step, building with -D REDUCE_LOCKSTEP_WIDTH=32 (or more) also drops their barriers.
+// The local size must be a power of two.
+#ifndef REDUCE_LOCKSTEP_WIDTH
+#define REDUCE_LOCKSTEP_WIDTH 0
+#endif
+#if REDUCE_LOCKSTEP_WIDTH >= 32
+#define REDUCE_TAIL_SYNC()
+#else
+#define REDUCE_TAIL_SYNC() barrier(CLK_LOCAL_MEM_FENCE)
+#endif
+
+// Unrolled final steps of a min tree
+void minTail(volatile local int* scratch, int lid, int N)
+{
+  #pragma unroll
+  for (int i = 32; i > 0; i /= 2)
+  {
+    if (i < N && lid < i)
+      scratch[lid] = min(scratch[lid], scratch[lid + i]);
+    REDUCE_TAIL_SYNC();
+  }
+}
+
+// Unrolled final steps of a max tree
+void maxTail(volatile local int* scratch, int lid, int N)
+{
+  #pragma unroll
+  for (int i = 32; i > 0; i /= 2)
+  {
+    if (i < N && lid < i)
+      scratch[lid] = max(scratch[lid], scratch[lid + i]);
+    REDUCE_TAIL_SYNC();
+  }
+}
+
+// Unrolled final steps of a sum tree
+void sumTail(volatile local long* scratch, int lid, int N)
+{
+  #pragma unroll
+  for (int i = 32; i > 0; i /= 2)
+  {
+    if (i < N && lid < i)
+      scratch[lid] += scratch[lid + i];
+    REDUCE_TAIL_SYNC();
+  }
+}
+
+kernel void minReduceSequential(global const int* input, global int* results, local int *scratch, int dataSize)
+{
+  // Initalize variables
+  int gid = get_global_id(0);
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Cache all values from global to local memory, work-items past the end of the data hold the identity
+  scratch[lid] = (gid < dataSize) ? input[gid] : INT_MAX;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate min value
+  for (int i = N / 2; i > 32; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] = min(scratch[lid], scratch[lid + i]);
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+  minTail(scratch, lid, N);
+
+  // Set result for the statistic
+  if (lid == 0)
+    atomic_min(results, scratch[0]);
+}
+
+kernel void maxReduceSequential(global const int* input, global int* results, local int *scratch, int dataSize)
+{
+  // Initalize variables
+  int gid = get_global_id(0);
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Cache all values from global to local memory, work-items past the end of the data hold the identity
+  scratch[lid] = (gid < dataSize) ? input[gid] : INT_MIN;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate max value
+  for (int i = N / 2; i > 32; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] = max(scratch[lid], scratch[lid + i]);
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+  maxTail(scratch, lid, N);
+
+  // Set result for the statistic
+  if (lid == 0)
+    atomic_max(results, scratch[0]);
+}
+
+kernel void sumReduceSequential(global const int* input, global long* results, local long *scratch, int dataSize)
+{
+  // Initalize variables
+  int gid = get_global_id(0);
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Cache all values from global to local memory, work-items past the end of the data hold the identity
+  scratch[lid] = (gid < dataSize) ? input[gid] : 0;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate sum
+  for (int i = N / 2; i > 32; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] += scratch[lid + i];
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+  sumTail(scratch, lid, N);
+
+  // Set result for the statistic
+  if (lid == 0)
+    ADD_LONG_RESULT(results, scratch[0]);
+}
+
+// Work-items past the end of the data count as zero, and every work-item reaches the barriers
+kernel void varianceReduceSequential(global const int* input, global long* results, local long *scratch, int mean, int dataSize)
+{
+  // Initalize variables
+  int gid = get_global_id(0);
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Cache all values from global to local memory and perform variance calculation
+  long deviation = (gid < dataSize) ? input[gid] - mean : 0;
+  scratch[lid] = deviation * deviation;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate sum
+  for (int i = N / 2; i > 32; i /= 2)
   {
-    // Cache all values from global to local memory and perform variance calculation
-    scratch[lid] = (input[gid] - mean) * (input[gid] - mean);
+    if (lid < i)
+      scratch[lid] += scratch[lid + i];
 
-    // Wait for local memory to be copied
+    // Wait for sync
     barrier(CLK_LOCAL_MEM_FENCE);
+  }
+  sumTail(scratch, lid, N);
+
+  // Set result for the statistic
+  if (lid == 0)
+    ADD_LONG_RESULT(results, scratch[0]);
+}
+
+// Partial statistics for the values of one work-group, matches the Stats struct in Kernel.hpp
+typedef struct
+{
+  ACC sum;
+  ACC sumSquares;
+  T min;
+  T max;
+  int count;
+  int padding;
+} Stats;
+
+// Work-group reductions use the OpenCL 2.0 work_group_reduce_* built-ins when built with -D USE_WORK_GROUP_BUILTINS,
+// or sub-group reductions when built with -D USE_SUB_GROUP_BUILTINS on devices with cl_intel_subgroups. Otherwise
+// they fall back to a tree in local memory, which works on every OpenCL 1.2 device. The host picks the path.
+#if defined(USE_SUB_GROUP_BUILTINS) && defined(cl_khr_subgroups)
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
+// Combines every work-item's statistics, leaving the work-group's totals in the first work-item's values
+void groupStats(T* minValue, T* maxValue, ACC* sum, ACC* sumSquares, local T* scratchMin, local T* scratchMax, local ACC* scratchSum, local ACC* scratchSquares)
+{
+#if defined(USE_WORK_GROUP_BUILTINS)
+  *minValue = work_group_reduce_min((ACC)*minValue);
+  *maxValue = work_group_reduce_max((ACC)*maxValue);
+  *sum = work_group_reduce_add(*sum);
+  *sumSquares = work_group_reduce_add(*sumSquares);
+#elif defined(USE_SUB_GROUP_BUILTINS)
+  // Reduce each sub-group, then the first sub-group reduces the sub-group results
+  int subGroup = get_sub_group_id();
+  int subLid = get_sub_group_local_id();
+  int subGroups = get_num_sub_groups();
+  int subSize = get_sub_group_size();
+  ACC minSub = sub_group_reduce_min((ACC)*minValue);
+  ACC maxSub = sub_group_reduce_max((ACC)*maxValue);
+  ACC sumSub = sub_group_reduce_add(*sum);
+  ACC squaresSub = sub_group_reduce_add(*sumSquares);
+  if (subLid == 0)
+  {
+    scratchMin[subGroup] = minSub;
+    scratchMax[subGroup] = maxSub;
+    scratchSum[subGroup] = sumSub;
+    scratchSquares[subGroup] = squaresSub;
+  }
 
-    // Calculate sum
-    for (int i = 1; i < N; i *= 2)
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (subGroup == 0)
+  {
+    minSub = T_MAX;
+    maxSub = T_MIN;
+    sumSub = 0;
+    squaresSub = 0;
+    for (int i = subLid; i < subGroups; i += subSize)
     {
-      if ((lid % (i * 2) == 0) && ((lid + i) < N))
-      {
-        scratch[lid] += scratch[lid + i];
-      }
+      minSub = min(minSub, (ACC)scratchMin[i]);
+      maxSub = max(maxSub, (ACC)scratchMax[i]);
+      sumSub += scratchSum[i];
+      squaresSub += scratchSquares[i];
+    }
+    *minValue = sub_group_reduce_min(minSub);
+    *maxValue = sub_group_reduce_max(maxSub);
+    *sum = sub_group_reduce_add(sumSub);
+    *sumSquares = sub_group_reduce_add(squaresSub);
+  }
+#else
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+  scratchMin[lid] = *minValue;
+  scratchMax[lid] = *maxValue;
+  scratchSum[lid] = *sum;
+  scratchSquares[lid] = *sumSquares;
 
-      // Wait for sync
-      barrier(CLK_LOCAL_MEM_FENCE);
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate every statistic in the same tree
+  for (int i = N / 2; i > 0; i /= 2)
+  {
+    if (lid < i)
+    {
+      scratchMin[lid] = min(scratchMin[lid], scratchMin[lid + i]);
+      scratchMax[lid] = max(scratchMax[lid], scratchMax[lid + i]);
+      scratchSum[lid] += scratchSum[lid + i];
+      scratchSquares[lid] += scratchSquares[lid + i];
     }
 
-    // Convert value back to normal (100 ^ 2 = 10,000)
-    scratch[lid] = scratch[lid] / 10000.0;
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+  *minValue = scratchMin[0];
+  *maxValue = scratchMax[0];
+  *sum = scratchSum[0];
+  *sumSquares = scratchSquares[0];
+#endif
+}
+
+// Calculates min, max, count, sum and sum of squares in a single read of the data. Each work-group writes
+// its partial statistics without atomics, which keeps sums in the accumulator type, and statsMerge combines them.
+// Each work-item first accumulates a strided range in private memory, so the grid can be sized to the device
+// rather than the data. The local size must be a power of two.
+kernel void statsReduce(global const T* input, global Stats* partials, local T* scratchMin, local T* scratchMax, local ACC* scratchSum, local ACC* scratchSquares, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Reduce a strided range in private memory, starting from each operation's identity
+  T minValue = T_MAX;
+  T maxValue = T_MIN;
+  ACC sum = 0;
+  ACC sumSquares = 0;
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+  {
+    T value = input[i];
+    minValue = min(minValue, value);
+    maxValue = max(maxValue, value);
+    sum += value;
+    sumSquares += (ACC)value * value;
+  }
+  groupStats(&minValue, &maxValue, &sum, &sumSquares, scratchMin, scratchMax, scratchSum, scratchSquares);
+
+  // Set partial results for the work-group
+  if (lid == 0)
+  {
+    // Every full pass of the grid gives the work-group N values, the last pass gives what is left of its range
+    int group = get_group_id(0);
+    int G = get_global_size(0);
+    Stats result;
+    result.sum = sum;
+    result.sumSquares = sumSquares;
+    result.min = minValue;
+    result.max = maxValue;
+    result.count = (dataSize / G) * N + clamp(dataSize % G - group * N, 0, N);
+    result.padding = 0;
+    partials[group] = result;
+  }
+}
+
+// Vector width of statsReduceVector, chosen by the host from the device's preferred vector width for T (2, 4, 8 or 16)
+#ifndef VECTOR_WIDTH
+#define VECTOR_WIDTH 4
+#endif
+#define VECTOR_JOIN(a, b) a ## b
+#define VECTOR_OF(type, width) VECTOR_JOIN(type, width)
+#define TV VECTOR_OF(T, VECTOR_WIDTH)
+#define ACCV VECTOR_OF(ACC, VECTOR_WIDTH)
+#define vloadV VECTOR_OF(vload, VECTOR_WIDTH)
+#define vstoreV VECTOR_OF(vstore, VECTOR_WIDTH)
+#define convert_ACCV VECTOR_OF(VECTOR_OF(convert_, ACC), VECTOR_WIDTH)
+
+// statsReduce with vector loads. Each work-item reduces a strided range of whole vectors lane by lane, then
+// combines its lanes before the work-group tree. Values after the last whole vector are read one at a time by the
+// first work-items of the grid. Writes the same partials as statsReduce, so statsMerge combines them.
+kernel void statsReduceVector(global const T* input, global Stats* partials, local T* scratchMin, local T* scratchMax, local ACC* scratchSum, local ACC* scratchSquares, int dataSize)
+{
+  // Initalize variables
+  int gid = get_global_id(0);
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+  int G = get_global_size(0);
+  int vectorCount = dataSize / VECTOR_WIDTH;
+  int remainder = dataSize % VECTOR_WIDTH;
+
+  // Reduce a strided range of vectors in private memory, one lane per value
+  TV minLanes = (TV)(T_MAX);
+  TV maxLanes = (TV)(T_MIN);
+  ACCV sumLanes = (ACCV)(0);
+  ACCV squareLanes = (ACCV)(0);
+  for (int i = gid; i < vectorCount; i += G)
+  {
+    TV values = vloadV(i, input);
+    ACCV wide = convert_ACCV(values);
+    minLanes = min(minLanes, values);
+    maxLanes = max(maxLanes, values);
+    sumLanes += wide;
+    squareLanes += wide * wide;
+  }
 
-    // Set result for the statistic
-    if (lid == 0)
+  // Combine the lanes
+  T minArray[VECTOR_WIDTH], maxArray[VECTOR_WIDTH];
+  ACC sumArray[VECTOR_WIDTH], squareArray[VECTOR_WIDTH];
+  vstoreV(minLanes, 0, minArray);
+  vstoreV(maxLanes, 0, maxArray);
+  vstoreV(sumLanes, 0, sumArray);
+  vstoreV(squareLanes, 0, squareArray);
+  T minValue = T_MAX;
+  T maxValue = T_MIN;
+  ACC sum = 0;
+  ACC sumSquares = 0;
+  for (int i = 0; i < VECTOR_WIDTH; i++)
+  {
+    minValue = min(minValue, minArray[i]);
+    maxValue = max(maxValue, maxArray[i]);
+    sum += sumArray[i];
+    sumSquares += squareArray[i];
+  }
+
+  // Values after the last whole vector
+  if (gid < remainder)
+  {
+    T value = input[vectorCount * VECTOR_WIDTH + gid];
+    minValue = min(minValue, value);
+    maxValue = max(maxValue, value);
+    sum += value;
+    sumSquares += (ACC)value * value;
+  }
+  groupStats(&minValue, &maxValue, &sum, &sumSquares, scratchMin, scratchMax, scratchSum, scratchSquares);
+
+  // Set partial results for the work-group
+  if (lid == 0)
+  {
+    // Whole vectors are counted like values in statsReduce, plus the group's share of the remainder
+    int group = get_group_id(0);
+    Stats result;
+    result.sum = sum;
+    result.sumSquares = sumSquares;
+    result.min = minValue;
+    result.max = maxValue;
+    result.count = ((vectorCount / G) * N + clamp(vectorCount % G - group * N, 0, N)) * VECTOR_WIDTH + clamp(remainder - group * N, 0, N);
+    result.padding = 0;
+    partials[group] = result;
+  }
+}
+
+// Second stage of statsReduce, a single work-group merges every partial into partials[0] of the results buffer
+kernel void statsMerge(global const Stats* partials, global Stats* results, local T* scratchMin, local T* scratchMax, local ACC* scratchSum, local ACC* scratchSquares, local int* scratchCount, int partialCount)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Each work-item merges a strided range of partials
+  T minValue = T_MAX;
+  T maxValue = T_MIN;
+  ACC sum = 0;
+  ACC sumSquares = 0;
+  int count = 0;
+  for (int i = lid; i < partialCount; i += N)
+  {
+    Stats partial = partials[i];
+    minValue = min(minValue, partial.min);
+    maxValue = max(maxValue, partial.max);
+    sum += partial.sum;
+    sumSquares += partial.sumSquares;
+    count += partial.count;
+  }
+  scratchMin[lid] = minValue;
+  scratchMax[lid] = maxValue;
+  scratchSum[lid] = sum;
+  scratchSquares[lid] = sumSquares;
+  scratchCount[lid] = count;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Merge the work-items' results
+  for (int i = N / 2; i > 0; i /= 2)
+  {
+    if (lid < i)
     {
-      atomic_add(results, scratch[lid]);
+      scratchMin[lid] = min(scratchMin[lid], scratchMin[lid + i]);
+      scratchMax[lid] = max(scratchMax[lid], scratchMax[lid + i]);
+      scratchSum[lid] += scratchSum[lid + i];
+      scratchSquares[lid] += scratchSquares[lid + i];
+      scratchCount[lid] += scratchCount[lid + i];
     }
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Set result for the statistics
+  if (lid == 0)
+  {
+    Stats result;
+    result.sum = scratchSum[0];
+    result.sumSquares = scratchSquares[0];
+    result.min = scratchMin[0];
+    result.max = scratchMax[0];
+    result.count = scratchCount[0];
+    result.padding = 0;
+    results[0] = result;
+  }
+}
+
+// Mean and M2 use double precision when the host builds with -D USE_FP64, matching the Moments type it reads back
+#ifdef USE_FP64
+typedef double moment_t;
+#else
+typedef float moment_t;
+#endif
+
+// Count, mean and sum of squared differences from the mean (M2) of a set of values, matches the Moments struct in Kernel.hpp
+typedef struct
+{
+  int count;
+  int padding;
+  moment_t mean;
+  moment_t m2;
+} Moments;
+
+// Combines the moments of two sets of values (Chan et al.)
+Moments mergeMoments(Moments a, Moments b)
+{
+  int count = a.count + b.count;
+  if (a.count == 0 || b.count == 0)
+    return (a.count == 0) ? b : a;
+
+  moment_t delta = b.mean - a.mean;
+  Moments result;
+  result.count = count;
+  result.padding = 0;
+  result.mean = a.mean + delta * b.count / count;
+  result.m2 = a.m2 + b.m2 + delta * delta * ((moment_t)a.count * b.count / count);
+  return result;
+}
+
+// Combines the moments of the work-items, leaving the work-group's moments in scratch[0]
+void groupMoments(Moments moments, local Moments* scratch)
+{
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+  scratch[lid] = moments;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Merge the work-items' moments
+  for (int i = N / 2; i > 0; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] = mergeMoments(scratch[lid], scratch[lid + i]);
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+}
+
+// Calculates the variance in one pass. Each work-item runs Welford's algorithm over a strided range, then the
+// work-group merges them and writes its moments to partials[group] for momentsMerge. The local size must be a power of two.
+kernel void varianceWelford(global const T* input, global Moments* partials, local Moments* scratch, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+
+  // Update the running mean and M2 with each value of a strided range
+  Moments moments = { 0, 0, 0, 0 };
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+  {
+    moment_t value = input[i];
+    moment_t delta = value - moments.mean;
+    moments.count++;
+    moments.mean += delta / moments.count;
+    moments.m2 += delta * (value - moments.mean);
+  }
+  groupMoments(moments, scratch);
+
+  // Set partial result for the work-group
+  if (lid == 0)
+    partials[get_group_id(0)] = scratch[0];
+}
+
+// Second stage of varianceWelford, a single work-group merges every partial into results[0]
+kernel void momentsMerge(global const Moments* partials, global Moments* results, local Moments* scratch, int partialCount)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Each work-item merges a strided range of partials
+  Moments moments = { 0, 0, 0, 0 };
+  for (int i = lid; i < partialCount; i += N)
+    moments = mergeMoments(moments, partials[i]);
+  groupMoments(moments, scratch);
+
+  // Set result for the statistic
+  if (lid == 0)
+    results[0] = scratch[0];
+}
+
+// Two-stage reductions without atomics. The first launch writes one partial per work-group, then a second launch
+// with a single work-group reduces the partials into results[0]. Each work-item starts by reducing a strided range,
+// so any number of values can be handled by any number of work-groups. The local size must be a power of two.
+kernel void minPartial(global const T* input, global T* results, local T* scratch, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Reduce a strided range in private memory
+  T value = T_MAX;
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+    value = min(value, input[i]);
+  scratch[lid] = value;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate min value
+  for (int i = N / 2; i > 0; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] = min(scratch[lid], scratch[lid + i]);
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Set partial result for the work-group
+  if (lid == 0)
+    results[get_group_id(0)] = scratch[0];
+}
+
+kernel void maxPartial(global const T* input, global T* results, local T* scratch, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Reduce a strided range in private memory
+  T value = T_MIN;
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+    value = max(value, input[i]);
+  scratch[lid] = value;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate max value
+  for (int i = N / 2; i > 0; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] = max(scratch[lid], scratch[lid + i]);
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Set partial result for the work-group
+  if (lid == 0)
+    results[get_group_id(0)] = scratch[0];
+}
+
+// Sums are widened to the accumulator type, use sumMerge for the second stage
+kernel void sumPartial(global const T* input, global ACC* results, local ACC* scratch, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Reduce a strided range in private memory
+  ACC value = 0;
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+    value += input[i];
+  scratch[lid] = value;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate sum
+  for (int i = N / 2; i > 0; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] += scratch[lid + i];
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
   }
+
+  // Set partial result for the work-group
+  if (lid == 0)
+    results[get_group_id(0)] = scratch[0];
+}
+
+kernel void sumMerge(global const ACC* input, global ACC* results, local ACC* scratch, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Reduce a strided range in private memory
+  ACC value = 0;
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+    value += input[i];
+  scratch[lid] = value;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Calculate sum
+  for (int i = N / 2; i > 0; i /= 2)
+  {
+    if (lid < i)
+      scratch[lid] += scratch[lid + i];
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Set partial result for the work-group
+  if (lid == 0)
+    results[get_group_id(0)] = scratch[0];
+}
+
+// Counts how many times each whole value between minValue and minValue + binCount - 1 appears, so exact quantiles can be
+// read from a prefix walk over the bins instead of sorting. Each work-group counts a strided range into a local copy of
+// the histogram, then adds its non-zero bins to the global one, which must start at zero. The local copy needs binCount
+// uints of local memory, histogramGlobal counts straight into global memory when it doesn't fit.
+kernel void histogramLocal(global const T* input, global uint* bins, local uint* localBins, int minValue, int binCount, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Clear the local histogram
+  for (int i = lid; i < binCount; i += N)
+    localBins[i] = 0;
+
+  // Wait for local memory to be cleared
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Count a strided range
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+    atomic_inc(&localBins[(int)input[i] - minValue]);
+
+  // Wait for sync
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Add the work-group's counts to the global histogram
+  for (int i = lid; i < binCount; i += N)
+  {
+    uint count = localBins[i];
+    if (count)
+      atomic_add(&bins[i], count);
+  }
+}
+
+kernel void histogramGlobal(global const T* input, global uint* bins, int minValue, int dataSize)
+{
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+    atomic_inc(&bins[(int)input[i] - minValue]);
 }
 
 // Parallel Selection Sort using global memory
 // ref - http://www.bealto.com/gpu-sorting_parallel-selection.html
-kernel void selectionSort(global const int* input, global int* output)
+kernel void selectionSort(global const T* input, global T* output, int dataSize)
 {
   int gid = get_global_id(0);
-  int N = get_global_size(0);
+  int N = dataSize;
   int pos = 0;
-  int iData = input[gid];
+
+  // Ignore work-items past the end of the data
+  if (gid >= N)
+    return;
+  T iData = input[gid];
 
   for (int j = 0; j < N; j++)
   {
-    int jData = input[j];
+    T jData = input[j];
     bool smallest = ((jData < iData) || (jData == iData && j < gid));
     pos += (smallest) ? 1 : 0;
   }
 
   // Store to output
   output[pos] = iData;
+}
+
+// LSD radix sort, RADIX_BITS of the key per pass starting from the least significant. Each pass runs radixCount,
+// radixScan and radixScatter, ping-ponging between two buffers, and every work-group owns one tile of local size keys.
+// Keys are the 32-bit pattern of the elements with the sign bit flipped, so negative values sort first. The host only
+// uses it for integer elements of up to 32 bits.
+#define RADIX_BITS 4
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+uint radixKey(T value)
+{
+  return (uint)value ^ 0x80000000u;
+}
+
+uint radixDigit(T key, int shift)
+{
+  return (radixKey(key) >> shift) & (RADIX_BUCKETS - 1);
+}
+
+// Exclusive prefix sum of one value per work-item, also returning the work-group's total
+uint groupScanExclusive(uint value, local uint* scratch, uint* total)
+{
+#if defined(USE_WORK_GROUP_BUILTINS)
+  *total = work_group_reduce_add(value);
+  return work_group_scan_exclusive_add(value);
+#else
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+  scratch[lid] = value;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Each step adds the value offset places back, doubling the span every sum covers
+  for (int offset = 1; offset < N; offset *= 2)
+  {
+    uint previous = (lid >= offset) ? scratch[lid - offset] : 0;
+
+    // Wait for every read before writing
+    barrier(CLK_LOCAL_MEM_FENCE);
+    scratch[lid] += previous;
+
+    // Wait for sync
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+  uint inclusive = scratch[lid];
+  *total = scratch[N - 1];
+
+  // Wait for every read so scratch can be reused
+  barrier(CLK_LOCAL_MEM_FENCE);
+  return inclusive - value;
+#endif
+}
+
+// Counts the digits of a work-group's tile. Counts are stored digit-major, so an exclusive scan over them gives the first
+// output position of every digit in every tile. The local size must be at least RADIX_BUCKETS.
+kernel void radixCount(global const T* keys, global uint* counts, local uint* localCounts, int shift, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int gid = get_global_id(0);
+
+  // Clear the work-group's counts
+  if (lid < RADIX_BUCKETS)
+    localCounts[lid] = 0;
+
+  // Wait for local memory to be cleared
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (gid < dataSize)
+    atomic_inc(&localCounts[radixDigit(keys[gid], shift)]);
+
+  // Wait for sync
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (lid < RADIX_BUCKETS)
+    counts[lid * get_num_groups(0) + get_group_id(0)] = localCounts[lid];
+}
+
+// Replaces the counts with their exclusive prefix sum, run as a single work-group that scans a local size chunk at a time
+kernel void radixScan(global uint* counts, local uint* scratch, int count)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+  uint carry = 0;
+
+  for (int base = 0; base < count; base += N)
+  {
+    int i = base + lid;
+    uint value = (i < count) ? counts[i] : 0;
+    uint total;
+    uint before = groupScanExclusive(value, scratch, &total);
+    if (i < count)
+      counts[i] = carry + before;
+    carry += total;
+  }
+}
+
+// Sorts a work-group's tile by the digit in local memory, one bit at a time with stable splits, then writes each key to
+// its digit's position from radixScan plus its rank among the tile's keys with that digit. Sorting the tile first keeps
+// the order of the previous pass and makes neighbouring work-items write neighbouring addresses.
+kernel void radixScatter(global const T* keys, global T* sorted, global const uint* offsets, local T* tile, local uint* digits, local uint* scratch, int shift, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int gid = get_global_id(0);
+  int group = get_group_id(0);
+  int N = get_local_size(0);
+  int tileSize = min(N, dataSize - group * N);
+
+  // Work-items past the data take the largest digit, so they end up after every key of the tile
+  T key = (gid < dataSize) ? keys[gid] : 0;
+  uint digit = (gid < dataSize) ? radixDigit(key, shift) : RADIX_BUCKETS - 1;
+
+  for (int bit = 0; bit < RADIX_BITS; bit++)
+  {
+    // Keys with a zero bit move to the front, keys with a one bit follow, both keeping their order
+    uint zero = ((digit >> bit) & 1) ? 0 : 1;
+    uint zeros;
+    uint before = groupScanExclusive(zero, scratch, &zeros);
+    int position = zero ? before : zeros + lid - before;
+    tile[position] = key;
+    digits[position] = digit;
+
+    // Wait for the tile to be rearranged
+    barrier(CLK_LOCAL_MEM_FENCE);
+    key = tile[lid];
+    digit = digits[lid];
+
+    // Wait for every read before the next split
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Find where each digit starts in the sorted tile
+  if (lid == 0 || digits[lid - 1] != digit)
+    scratch[digit] = lid;
+
+  // Wait for sync
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Store to output
+  if (lid < tileSize)
+    sorted[offsets[digit * get_num_groups(0) + group] + lid - scratch[digit]] = key;
+}
+
+// Comparison sort for devices where the radix scatter performs badly: bitonicSortLocal sorts every tile of local size
+// values in local memory, then mergePath merges pairs of sorted runs, doubling the run width each launch until one run
+// covers the data. The local size must be a power of two.
+kernel void bitonicSortLocal(global const T* input, global T* output, local T* tile, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int gid = get_global_id(0);
+  int N = get_local_size(0);
+
+  // Values past the data are the largest possible, so they sort to the end of the tile
+  tile[lid] = (gid < dataSize) ? input[gid] : T_MAX;
+
+  // Wait for local memory to be copied
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Build bitonic sequences of size k, then merge each one with compare-exchanges of distance j
+  for (int k = 2; k <= N; k *= 2)
+  {
+    for (int j = k / 2; j > 0; j /= 2)
+    {
+      int partner = lid ^ j;
+      if (partner > lid)
+      {
+        T a = tile[lid];
+        T b = tile[partner];
+        bool ascending = (lid & k) == 0;
+        if ((a > b) == ascending)
+        {
+          tile[lid] = b;
+          tile[partner] = a;
+        }
+      }
+
+      // Wait for sync
+      barrier(CLK_LOCAL_MEM_FENCE);
+    }
+  }
+
+  // Store to output
+  if (gid < dataSize)
+    output[gid] = tile[lid];
+}
+
+#ifndef MERGE_ITEMS
+#define MERGE_ITEMS 8
+#endif
+
+// Merges each pair of sorted runs of width values into one run. Every work-item writes MERGE_ITEMS consecutive outputs:
+// a binary search along its merge path diagonal finds how many come from each run before it, then it merges
+// sequentially from there. Ties take the first run's value, so the merge is stable.
+kernel void mergePath(global const T* input, global T* output, int width, int dataSize)
+{
+  // Initalize variables
+  int first = get_global_id(0) * MERGE_ITEMS;
+
+  // Ignore work-items past the end of the data
+  if (first >= dataSize)
+    return;
+
+  int start = first / (2 * width) * (2 * width);
+  int lengthA = min(width, dataSize - start);
+  int lengthB = min(width, max(dataSize - start - width, 0));
+  global const T* a = input + start;
+  global const T* b = a + lengthA;
+
+  // Find how many of the first diagonal outputs come from run a
+  int diagonal = first - start;
+  int low = max(0, diagonal - lengthB);
+  int high = min(diagonal, lengthA);
+  while (low < high)
+  {
+    int middle = (low + high) / 2;
+    if (a[middle] <= b[diagonal - 1 - middle])
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  // Merge from the diagonal
+  int i = low;
+  int j = diagonal - low;
+  int last = min(first + MERGE_ITEMS, start + lengthA + lengthB);
+  for (int k = first; k < last; k++)
+  {
+    if (j >= lengthB || (i < lengthA && a[i] <= b[j]))
+      output[k] = a[i++];
+    else
+      output[k] = b[j++];
+  }
+}
+
+// Radix select finds the value at any rank without sorting, narrowing the key SELECT_BITS at a time from the most
+// significant end. Each pass counts the next digit of every key that matches the digits already chosen, and the host
+// walks the counts to choose the digit holding the rank. Uses the same keys as the radix sort.
+#define SELECT_BITS 8
+#define SELECT_BUCKETS (1 << SELECT_BITS)
+
+kernel void radixSelectCount(global const T* input, global uint* bins, local uint* localBins, uint prefix, uint prefixMask, int shift, int dataSize)
+{
+  // Initalize variables
+  int lid = get_local_id(0);
+  int N = get_local_size(0);
+
+  // Clear the local counts
+  for (int i = lid; i < SELECT_BUCKETS; i += N)
+    localBins[i] = 0;
+
+  // Wait for local memory to be cleared
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Count a strided range, skipping keys outside the chosen prefix
+  for (int i = get_global_id(0); i < dataSize; i += get_global_size(0))
+  {
+    uint key = radixKey(input[i]);
+    if ((key & prefixMask) == prefix)
+      atomic_inc(&localBins[(key >> shift) & (SELECT_BUCKETS - 1)]);
+  }
+
+  // Wait for sync
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Add the work-group's counts to the global ones
+  for (int i = lid; i < SELECT_BUCKETS; i += N)
+  {
+    uint count = localBins[i];
+    if (count)
+      atomic_add(&bins[i], count);
+  }
 }
\ No newline at end of file
@@ -1,12 +1,12 @@
 #include <locale>
 #include <cmath>
 #include "Parser.hpp"
-#include "Kernel.hpp"
+#include "Benchmark.hpp"
 
 /*
-The application performs like a console app, where commands are input based on pre-set options. Both the small and large 'temp_lincolnshire' datasets are used within the application. The application allows switching between computing devices (platform and device), if required, before calculating the temperature data's statistics. The data is loaded traditionally using a standard C++ approach before being passed through multiple reduce kernels to calculate the statistics. Additionally, Selection Sort is used to sort the data into ascending order, providing the ability to calculate more advanced statistics, such as median, 1st quartile, and 3rd quartile. This sorting algorithm is based on an implementation written by Bainville (2011).
+The application performs like a console app, where commands are input based on pre-set options. Both the small and large 'temp_lincolnshire' datasets are used within the application, either as text or as compressed archives made with the --compress option. The application allows switching between computing devices (platform and device), if required, before calculating the temperature data's statistics. The file is memory mapped and split into chunks that are parsed on every thread, where a SIMD scanner finds the line and field boundaries and the fields are read as fixed-point numbers, and the temperature column is uploaded to the device while the rest of the file is still being parsed. The minimum, maximum, mean and standard deviation are then calculated by a single pass over the data. If sorting is enabled, the median, 1st quartile, 3rd quartile and a ladder of percentiles are read from a histogram of the values when their range is small enough, otherwise from a radix select of each rank, or from a radix sort or bitonic merge sort of the data when many ranks are needed. The parallel Selection Sort based on an implementation written by Bainville (2011) remains as the fallback for local sizes the other sorts can't use.
 
-The kernels used within the implementation are inspired by the 'reduce_add_3' kernel presented in Tutorial 3 (Millard, 2020). The approach used loads the temperature data (floating-point numbers) from the selected file into an integer vector. These values are multiplied by 100 to ensure that the floating-point values are retained when passed into the integer vector. This method provides the ability to use atomic operations, which only accept integer values as input. Additionally, barrier functions are used throughout each kernel. Both barrier functions and atomic operations assist with work-item synchronisation, preventing data conflicts and ensuring that every work item has reached the same point in its processing, which is crucial for calculating the statistics correctly. Once the kernels calculations have completed, the output values are divided by 100 to convert the values to the correct format.
+The kernels used within the implementation are inspired by the 'reduce_add_3' kernel presented in Tutorial 3 (Millard, 2020). The temperature data (floating-point numbers) is stored as integers, multiplied by 100 so the two decimal places are retained. The statistics are reduced in two stages without atomic operations: every work-group reads a strided range of the data and reduces it in local memory, or with the work-group and sub-group built-ins where the device supports them, writing one partial result per work-group, and a second launch with a single work-group merges the partials. Atomic operations are only left in the histogram and radix kernels, which count values into bins, and in the older atomic reduction kernels kept for the benchmark. Barrier functions synchronise the work-items of each work-group, ensuring that every work-item has reached the same point in its processing before local memory is read. Once the kernels calculations have completed, the output values are divided by 100 to convert the values to the correct format.
 
 References:
 	- Bainville, E. (2011) OpenCL Sorting. Parallel Selection Sort. Bealto. Available from: http://www.bealto.com/gpu-sorting_parallel-selection.html [accessed 13 April 2021].
@@ -20,6 +20,19 @@ int main(int argc, char** argv) {
 	Helper helper;
 	Parser parser;
 
+	// Compress a dataset for reading in parallel: weather-analysis --compress <text file> [compressed file]
+	if (argc >= 3 && string(argv[1]) == "--compress")
+	{
+		string archive_url = (argc >= 4) ? argv[3] : string(argv[2]) + BlockArchive::extension();
+		if (!BlockArchive::compressFile(argv[2], archive_url))
+		{
+			cerr << "Unable to compress " << argv[2] << " into " << archive_url << endl;
+			return 1;
+		}
+		cout << "Compressed " << argv[2] << " into " << archive_url << endl;
+		return 0;
+	}
+
 	helper.handleInput();
 
 	//detect any potential exceptions
@@ -31,27 +44,8 @@ int main(int argc, char** argv) {
 		//create a queue to which we will push commands for the device
 		cl::CommandQueue queue(context, CL_QUEUE_PROFILING_ENABLE);
 
-		//2.2 Load & build the device code
-		cl::Program::Sources sources;
-
-		AddSources(sources, "kernels/my_kernels.cl");
-
-		cl::Program program(context, sources);
-
-		//build and debug the kernel code
-		try {
-			program.build();
-		}
-		catch (const cl::Error& err) {
-			cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << endl;
-			cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << endl;
-			cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << endl;
-			throw err;
-		}
-
-		// Part 3 - memory allocation
-		// Instantiate kernel
-		Kernel kernel(context, queue, program);
+		//2.2 Load & build the device code, specialised for the temperature type and the selected device
+		Kernel<mytype> kernel(context, queue);
 
 		// Display console file info
 		helper.displayFileOptions();
@@ -61,152 +55,101 @@ int main(int argc, char** argv) {
 		file_url = helper.selectFile(file_url); // Select data file
 		bool sortFlag = helper.enableSorting(); // Calculates all stats
 
-		// Read in data
-		vector<mytype> temperatures = parser.readFile(file_url);
-
 		// Set local size variables
-		size_t local_size = 1024;
-		size_t padding_size = temperatures.size() % local_size;
-		size_t pad_difference = local_size - padding_size;
-		size_t scratch_size = local_size * sizeof(mytype);
-
-		// Pad the data
-		int pad_value = 3;
-		temperatures = parser.padData(temperatures, local_size, padding_size, pad_value);
-		
+		size_t local_size = kernel.statsLocalSize(1024); // halved until the statistics' scratch fits the device
+
+		// Read in data, uploading the temperature column in chunks while the rest of the file is parsed
+		cl::Buffer buffer_input;
+		vector<cl::Event> upload_events;
+		Records records = parser.readFile(file_url, [&](const Records& parsed, size_t first_row, size_t row_count, size_t expected_rows) {
+			// Allocate the input buffer for every row the file can hold
+			if (first_row == 0)
+				buffer_input = cl::Buffer(context, CL_MEM_READ_ONLY, max(expected_rows, (size_t)1) * sizeof(mytype));
+			if (row_count)
+				upload_events.push_back(kernel.writeBufferAsync(buffer_input, parsed.temperature, first_row, row_count));
+		});
+
+		// No statistics can be calculated without records
+		if (records.size() == 0)
+		{
+			cerr << "\nNo records in " << file_url << ", there are no statistics to calculate." << endl;
+			return 0;
+		}
+
 		// Set size variables
-		size_t data_size = temperatures.size(); //number of elements
-		size_t vec_size = data_size * sizeof(mytype); // size in bytes
-		size_t initial_data_size = data_size - pad_difference;
-		size_t wg_size = data_size / local_size;
+		size_t initial_data_size = records.size();
+		size_t global_size = max((initial_data_size + local_size - 1) / local_size, (size_t)1) * local_size; // kernels ignore work-items past the data
+		size_t wg_size = kernel.gridGroups((initial_data_size + kernel.vectorWidth - 1) / kernel.vectorWidth, local_size, kernel.statsScratchBytes(local_size)); // sized to the device, each work-item reduces a strided range
+
+		// Wait for the temperatures to reach the device
+		cl::Event::waitForEvents(upload_events);
+		queue.finish();
 
 		size_t n_stats = 7; //number of statistics
-		size_t stats_size = n_stats * sizeof(mytype); //size in bytes
 
 		// Host - output
-		vector<mytype> out_temps(data_size);
-		vector<mytype> core_data(initial_data_size);
 		vector<float> statistics(n_stats);
 
 		// Set kernel related vectors
-		vector<string> kernelNames = { "minReduce", "maxReduce", "sumReduce", "varianceReduce" };
+		vector<string> kernelNames = { kernel.statsKernelName(), "statsMerge" };
 		vector<cl::Event> events;
 
 		cout << "  Local size set to: " << local_size << endl;
+		cout << "  Vector width: " << kernel.vectorWidth << endl;
+		cout << "  Build options: " << kernel.buildOptions << endl;
 		cout << "  Number of work-groups: " << wg_size << endl;
-		cout << "  Padding increase: " << pad_difference << endl;
-		cout << "  Number of records + padding: " << data_size << endl;
+		cout << "  Global size: " << global_size << endl;
 		
 		cout << "\nCalculating statistics..." << endl;
 //---------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------
-		// Calculate first three stats - min, max, mean
-		// Create input buffer and copy to device memory
-		cl::Buffer buffer_input(context, CL_MEM_READ_ONLY, vec_size);
-		queue.enqueueWriteBuffer(buffer_input, CL_TRUE, 0, vec_size, &temperatures[0]);
-
-		// Iterate over first three kernels
-		for (int i = 0; i < 3; ++i)
-		{
-			// Create output buffer and fill it with zeros
-			cl::Buffer buffer_output = kernel.createBuffer(vec_size);
-
-			//4.2 Setup the kernel
-			cl::Event kernelEvent;
-
-			cl::Kernel activeKernel = kernel.setupKernel(kernelNames[i], buffer_input, buffer_output, scratch_size);
-
-			// Execute kernel
-			kernel.executeKernel(kernelNames[i], activeKernel, data_size, local_size, kernelEvent);
-
-			// Copy the data from device to host
-			out_temps = kernel.readKernelBuffer(buffer_output, vec_size, out_temps);
-
-			// Remove padded values
-			core_data = parser.removePad(out_temps, initial_data_size);
-
-			// Add kernel event to events vector
-			events.push_back(kernelEvent);
-
-			// Set statistic value
-			if (i == 2) // mean
-				statistics[i] = ((float)core_data[0] / initial_data_size) / 100.f;
-			else 
-				statistics[i] = core_data[0] / 100.f;
-		}
-
-//---------------------------------------------------------------------------------
-//---------------------------------------------------------------------------------
-		// Calculate standard deviation
-		// Set kernel variables
-		int mean = statistics[2] * 100;
-		cl::Event stdEvent;
-
-		// Create output buffer and fill it with zeros
-		cl::Buffer buffer_output = kernel.createBuffer(vec_size);
-
-		// Setup kernel
-		cl::Kernel calcStd = kernel.setupKernel(kernelNames[3], buffer_input, buffer_output, scratch_size, mean, initial_data_size);
-
-		// Execute kernel
-		kernel.executeKernel(kernelNames[3], calcStd, data_size, local_size, stdEvent);
-
-		// Copy the result from device to host
-		out_temps = kernel.readKernelBuffer(buffer_output, vec_size, out_temps);
-
-		// Add kernel event to events list
-		events.push_back(stdEvent);
-
-		// Set standard deviation
-		statistics[3] = sqrt((float)out_temps[0] / initial_data_size);
+		// Calculate min, max, mean and standard deviation in a single pass, the per work-group partials are merged
+		// by a second single work-group launch so no atomics are needed
+		Kernel<mytype>::Stats totals = kernel.reduceStats(buffer_input, initial_data_size, local_size, wg_size, events);
+
+		// Set statistic values, variance is the mean of the squares minus the square of the mean
+		double mean = (double)totals.sum / totals.count;
+		double variance = (double)totals.sumSquares / totals.count - mean * mean;
+		statistics[0] = totals.min / 100.f;
+		statistics[1] = totals.max / 100.f;
+		statistics[2] = mean / 100.f;
+		statistics[3] = sqrt(max(variance, 0.0)) / 100.f;
 		//---------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------
-		// Calculate remaining statistics - median, Q1, Q3 (requires sorted vector)
+		// Calculate remaining statistics - median, Q1, Q3 and the percentile ladder, all read from one histogram or sort
+		vector<double> percentiles = { 1, 5, 25, 50, 75, 95, 99 };
+		vector<double> percentile_values;
+		Interpolation percentile_rule = Interpolation::Linear;
 		if (sortFlag)
 		{
-			// Set kernel variables
-			cl::Event sortEvent;
-
-			// Create output buffer and fill it with zeros
-			cl::Buffer buffer_sorted = kernel.createBuffer(vec_size);
-
-			// Setup the kernel
-			kernelNames.push_back("selectionSort");
-			cl::Kernel sortData = kernel.setupKernel(kernelNames[4], buffer_input, buffer_sorted);
-
-			// Execute kernel
-			kernel.executeKernel(kernelNames[4], sortData, data_size, NULL, sortEvent);
-
-			// Copy the result from device to host
-			out_temps = kernel.readKernelBuffer(buffer_sorted, vec_size, out_temps);
-
-			// Remove padded values from sorted data
-			core_data = parser.removePad(out_temps, pad_value);
-
-			// Add kernel event to events list
-			events.push_back(sortEvent);
-
-			// Calculate median
-			if (initial_data_size % 2 == 0)
-			{
-				// Even dataset size
-				unsigned int half_size = initial_data_size / 2;
-				mytype half_avg = (core_data[half_size] + core_data[half_size + 1]) / 2;
-				statistics[4] = half_avg / 100.f;
-			}
-			// Odd dataset size
-			else
-				statistics[4] = core_data[round(initial_data_size * 0.5)] / 100.f;
-
-			// Calculate remaining statistics
-			statistics[5] = core_data[round(initial_data_size * 0.25)] / 100.f; // Q1
-			statistics[6] = core_data[round(initial_data_size * 0.75)] / 100.f; // Q3
+			percentile_values = kernel.percentiles(buffer_input, initial_data_size, totals.min, totals.max, percentiles, percentile_rule, local_size, kernelNames, events);
+			for (double& value : percentile_values)
+				value /= 100;
+
+			// Set statistic values
+			statistics[4] = percentile_values[3]; // Median
+			statistics[5] = percentile_values[2]; // Q1
+			statistics[6] = percentile_values[4]; // Q3
 		}
 		//---------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------
 
 		// Output information to console
 		helper.outputInfo(statistics, kernelNames, events, sortFlag);
+		if (sortFlag)
+			helper.outputPercentiles(percentiles, percentile_values, percentile_rule);
+
+		// Compare the alternative reductions, element types, sorts, radix select and parsers on the selected device
+		if (helper.benchmarkFlag)
+		{
+			Benchmark benchmark(kernel);
+			benchmark.runReductions(buffer_input, initial_data_size, global_size, local_size, (int)round(mean));
+			benchmark.runElementTypes(context, queue, records.temperature, local_size);
+			benchmark.runSorts(buffer_input, initial_data_size, local_size);
+			benchmark.runParsers(file_url);
+			benchmark.runFileReaders(file_url);
+			benchmark.outputResults();
+		}
 	}
 	catch (cl::Error err) {
 		cerr << "\nERROR: " << err.what() << ", " << getErrorString(err.err()) << endl;